@@ -0,0 +1,139 @@
+// compress.c
+
+#include "compress.h"
+#include <string.h>
+#include <stdint.h>
+
+// A sequence is a token byte, the literal run, then (except for the last
+// sequence of a block) a 2-byte little-endian offset back into the output.
+// The token holds the literal length in its high nibble and the match length
+// minus MIN_MATCH in its low nibble; a nibble of 15 is continued by bytes that
+// are added to it, each 255 except the last.
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static int hashSequence(uint32_t sequence) {
+    return (int)((sequence * 2654435761u) >> (32 - HASH_BITS));
+}
+
+// Write the continuation bytes of a length whose nibble is 15. Returns the new
+// output position, or -1 if dst is full.
+static int putLength(unsigned char *dst, int dstCapacity, int op, int length) {
+    for (length -= 15; length >= 255; length -= 255) {
+        if (op >= dstCapacity) return -1;
+        dst[op++] = 255;
+    }
+    if (op >= dstCapacity) return -1;
+    dst[op++] = (unsigned char)length;
+    return op;
+}
+
+// Write one sequence; a matchLength of 0 ends the block. Returns the new output
+// position, or -1 if dst is full.
+static int putSequence(unsigned char *dst, int dstCapacity, int op,
+                       const unsigned char *literals, int literalLength, int offset, int matchLength) {
+    if (op >= dstCapacity) return -1;
+    int token = op++;
+    int matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+    dst[token] = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+    if (literalLength >= 15 && (op = putLength(dst, dstCapacity, op, literalLength)) == -1) return -1;
+    if (op + literalLength > dstCapacity) return -1;
+    memcpy(dst + op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0) {
+        return op;
+    }
+    if (op + 2 > dstCapacity) return -1;
+    dst[op++] = (unsigned char)(offset & 0xff);
+    dst[op++] = (unsigned char)(offset >> 8);
+    if (matchCode >= 15 && (op = putLength(dst, dstCapacity, op, matchCode)) == -1) return -1;
+    return op;
+}
+
+int compressBlock(const unsigned char *src, int srcSize, unsigned char *dst, int dstCapacity) {
+    int table[1 << HASH_BITS];  // Last position of each hashed 4-byte sequence
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+        table[i] = -1;
+    }
+
+    int anchor = 0;  // Start of the pending literal run
+    int ip = 0;
+    int op = 0;
+    while (ip + MIN_MATCH <= srcSize) {
+        uint32_t sequence = read32(src + ip);
+        int h = hashSequence(sequence);
+        int ref = table[h];
+        table[h] = ip;
+
+        if (ref < 0 || ip - ref > MAX_OFFSET || read32(src + ref) != sequence) {
+            ip++;
+            continue;
+        }
+
+        int matchLength = MIN_MATCH;
+        while (ip + matchLength < srcSize && src[ref + matchLength] == src[ip + matchLength]) {
+            matchLength++;
+        }
+        op = putSequence(dst, dstCapacity, op, src + anchor, ip - anchor, ip - ref, matchLength);
+        if (op == -1) return 0;
+        ip += matchLength;
+        anchor = ip;
+    }
+
+    op = putSequence(dst, dstCapacity, op, src + anchor, srcSize - anchor, 0, 0);
+    return op == -1 ? 0 : op;
+}
+
+// Read the continuation bytes of a length whose nibble is 15. Returns the new
+// input position, or -1 if the block ends first.
+static int getLength(const unsigned char *src, int srcSize, int ip, int *length) {
+    unsigned char byte;
+    do {
+        if (ip >= srcSize) return -1;
+        byte = src[ip++];
+        *length += byte;
+    } while (byte == 255);
+    return ip;
+}
+
+int decompressBlock(const unsigned char *src, int srcSize, unsigned char *dst, int dstCapacity) {
+    int ip = 0;
+    int op = 0;
+    while (ip < srcSize) {
+        int token = src[ip++];
+
+        int literalLength = token >> 4;
+        if (literalLength == 15 && (ip = getLength(src, srcSize, ip, &literalLength)) == -1) return -1;
+        if (ip + literalLength > srcSize || op + literalLength > dstCapacity) return -1;
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == srcSize) {
+            break;  // The last sequence has no match
+        }
+        if (ip + 2 > srcSize) return -1;
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        int matchLength = token & 15;
+        if (matchLength == 15 && (ip = getLength(src, srcSize, ip, &matchLength)) == -1) return -1;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > op || op + matchLength > dstCapacity) return -1;
+
+        // Byte by byte: a match may overlap the bytes it produces
+        for (int i = 0; i < matchLength; i++) {
+            dst[op + i] = dst[op - offset + i];
+        }
+        op += matchLength;
+    }
+    return op;
+}
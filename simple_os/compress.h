@@ -0,0 +1,17 @@
+// compress.h
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+// LZ77 block compression in the style of LZ4: a byte-aligned stream of
+// literal runs and back references, fast enough to run on every page eviction
+
+// Compress srcSize bytes into dst. Returns the compressed size, or 0 if the
+// result would not fit in dstCapacity.
+int compressBlock(const unsigned char *src, int srcSize, unsigned char *dst, int dstCapacity);
+
+// Decompress a block produced by compressBlock. Returns the decompressed size,
+// or -1 if the block is corrupt or would overflow dstCapacity.
+int decompressBlock(const unsigned char *src, int srcSize, unsigned char *dst, int dstCapacity);
+
+#endif
@@ -26,9 +26,9 @@
 #include "interpreter.h"
 
 #define MAX_ARGS_SIZE 7
-#define NUM_THREADS 2
 
-pthread_t workerThreads[NUM_THREADS];  // Array to hold thread IDs
+pthread_t workerThreads[MAX_WORKERS];  // Array to hold thread IDs
+int workerCount = 2;                   // Number of MT workers, set by the workers command
 pthread_mutex_t readyQueueMutex;       // Mutex to control access to the ready queue
 int multithreadEnabled = 0;            // Flag to indicate if multithreading is enabled
 int quitRequested = 0;                 // Flag to indicate if quit is called in any worker threads
@@ -59,6 +59,16 @@ int badcommandCd() {
     return 5;
 }
 
+int badcommandPagePolicy() {
+    printf("Bad command: pagepolicy\n");
+    return 6;
+}
+
+int badcommandResize() {
+    printf("Bad command: resize\n");
+    return 7;
+}
+
 int help();
 int quit();
 int set(char *var, char *value[], int value_size);
@@ -69,11 +79,44 @@ int my_mkdir(char *name);
 int touch(char *path);
 int cd(char *path);
 int run(char *script);
-int exec(char *prog1, char *prog2, char *prog3, char *policy, int background, int multithread);
+int pagepolicy(char *name);
+int prefetch(char *pages);
+int resize(char *store, char *size);
+int loadcontrol(char *mode);
+int quota(char *mode);
+int swapcache(char *bytes);
+int pagein(char *mode);
+int workers(char *count);
+int readyqueue(char *backend);
+int exec(char **progs, int progCount, char *policy, int background, int multithread);
+
+// Append a program name to a growing list of exec programs
+static void addProgram(char ***progs, int *count, int *capacity, const char *name) {
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *progs = (char **)realloc(*progs, sizeof(char *) * *capacity);
+    }
+    (*progs)[(*count)++] = strdup(name);
+}
+
+// Append the programs listed in a manifest file, separated by whitespace.
+// Returns -1 if the manifest cannot be opened.
+static int readManifest(const char *path, char ***progs, int *count, int *capacity) {
+    FILE *manifest = fopen(path, "r");
+    if (manifest == NULL) {
+        return -1;
+    }
+    char name[256];
+    while (fscanf(manifest, "%255s", name) == 1) {
+        addProgram(progs, count, capacity, name);
+    }
+    fclose(manifest);
+    return 0;
+}
 
 // Add definition of str_isalphanum function
-int str_isalphanum(char *name) {
-    for (char *ptr = name; *ptr != '\0'; ptr++) {
+int str_isalphanum(const char *name) {
+    for (const char *ptr = name; *ptr != '\0'; ptr++) {
         if (!(isdigit(*ptr) || isalpha(*ptr))) {
             return 0; // Return 0 if a non-alphanumeric character is encountered
         }
@@ -97,7 +140,7 @@ int interpreter(char *command_args[], int args_size) {
     if (args_size < 1) {
         return badcommand();
     }
-    if (args_size > MAX_ARGS_SIZE) {
+    if (args_size > MAX_ARGS_SIZE && strcmp(command_args[0], "exec") != 0) {
         return badcommandTooLong();
     }
 
@@ -146,18 +189,57 @@ int interpreter(char *command_args[], int args_size) {
         if (args_size != 2) return badcommand();
         return run(command_args[1]);
 
+    } else if (strcmp(command_args[0], "pagepolicy") == 0) {
+        if (args_size > 2) return badcommand();
+        return pagepolicy(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "prefetch") == 0) {
+        if (args_size != 2) return badcommand();
+        return prefetch(command_args[1]);
+
+    } else if (strcmp(command_args[0], "loadcontrol") == 0) {
+        if (args_size > 2) return badcommand();
+        return loadcontrol(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "quota") == 0) {
+        if (args_size > 2) return badcommand();
+        return quota(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "swapcache") == 0) {
+        if (args_size > 2) return badcommand();
+        return swapcache(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "pagein") == 0) {
+        if (args_size > 2) return badcommand();
+        return pagein(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "workers") == 0) {
+        if (args_size > 2) return badcommand();
+        return workers(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "readyqueue") == 0) {
+        if (args_size > 2) return badcommand();
+        return readyqueue(args_size == 2 ? command_args[1] : NULL);
+
+    } else if (strcmp(command_args[0], "resize") == 0) {
+        if (args_size != 1 && args_size != 3) return badcommand();
+        return resize(args_size == 3 ? command_args[1] : NULL, args_size == 3 ? command_args[2] : NULL);
+
     } else if (strcmp(command_args[0], "exec") == 0) {
-        // Parse exec command, including optional arguments
-        if (args_size < 3 || args_size > 7) {
+        // Parse exec command, including optional arguments. Any number of
+        // programs may be given, directly or as @MANIFEST files listing them.
+        if (args_size < 3) {
             return badcommand();
         }
 
         int progCount = 0;
-        char *progs[3] = {NULL, NULL, NULL};
+        int progCapacity = args_size;
+        char **progs = (char **)malloc(sizeof(char *) * progCapacity);
         char *policy = NULL;
+        int errorCode = 0;
 
         // Traverse command arguments
-        for (int i = 1; i < args_size; i++) {
+        for (int i = 1; i < args_size && errorCode == 0; i++) {
             if (strcmp(command_args[i], "MT") == 0) {
                 multithread = 1;
             } else if (strcmp(command_args[i], "#") == 0) {
@@ -168,24 +250,28 @@ int interpreter(char *command_args[], int args_size) {
                        strcmp(command_args[i], "AGING") == 0 ||
                        strcmp(command_args[i], "RR30") == 0) {
                 policy = command_args[i];
-            } else if (progCount < 3) {
-                progs[progCount++] = command_args[i];
+            } else if (command_args[i][0] == '@') {
+                if (readManifest(command_args[i] + 1, &progs, &progCount, &progCapacity) == -1) {
+                    errorCode = badcommandFileDoesNotExist();
+                }
             } else {
-                return badcommand(); // Too many program arguments
+                addProgram(&progs, &progCount, &progCapacity, command_args[i]);
             }
         }
 
-        if (policy == NULL) {
-            return badcommand(); // Scheduling policy is required
+        if (errorCode == 0 && (policy == NULL || progCount == 0)) {
+            errorCode = badcommand(); // Scheduling policy and a program are required
         }
 
-        // Assign programs
-        char *prog1 = progs[0];
-        char *prog2 = progs[1];
-        char *prog3 = progs[2];
-
         // Call exec function, passing background and multithread flags
-        return exec(prog1, prog2, prog3, policy, background, multithread);
+        if (errorCode == 0) {
+            errorCode = exec(progs, progCount, policy, background, multithread);
+        }
+        for (int i = 0; i < progCount; i++) {
+            free(progs[i]);
+        }
+        free(progs);
+        return errorCode;
     }
     else return badcommand();
 }
@@ -198,18 +284,44 @@ help                Displays all the commands\n \
 quit                Exits / terminates the shell with “Bye!”\n \
 set VAR STRING      Assigns a value to shell memory\n \
 print VAR           Displays the STRING assigned to VAR\n \
-run SCRIPT.TXT      Executes the file SCRIPT.TXT\n";
+run SCRIPT.TXT      Executes the file SCRIPT.TXT\n \
+pagepolicy [POLICY] Selects LRU, CLOCK, SECOND_CHANCE, 2Q or ARC page replacement\n \
+prefetch PAGES      Sets the largest read-ahead window on page faults (0 disables)\n \
+loadcontrol [on|off] Suspends RR processes whose working sets do not fit in memory\n \
+quota [MODE]        Limits resident pages per process: none, equal, proportional or pff\n \
+swapcache [BYTES]   Sets the compressed swap cache capacity (0 disables) or shows its hit rate\n \
+pagein [sync|async] Reads faulting RR pages in the background while other processes run\n \
+workers [COUNT]     Sets how many workers exec MT starts (one per core scales best)\n \
+readyqueue [MODE]   Shares MT ready processes: shared (one lock), deques (stealing) or lockfree\n \
+resize [STORE SIZE] Resizes framestore (lines), framesize (lines) or varstore (variables)\n";
     printf("%s\n", help_string);
     return 0;
 }
 
+// Let the workers of an earlier MT exec run out of processes and exit, so the
+// pool and the memory they use can change, and stop the shell if one of their
+// scripts quit. A script running on a worker cannot wait for its own pool;
+// returns -1 there.
+static int waitForWorkers() {
+    if (isWorkerThread()) {
+        return -1;
+    }
+    joinWorkers();
+    if (quitRequested) {
+        removeBackingStore();
+        exit(0);
+    }
+    return 0;
+}
+
 int quit() {
     printf("Bye!\n");
 
-    if (multithreadEnabled) {
-        quitRequested = 1;
+    if (isWorkerThread()) {
+        quitRequested = 1;  // The shell exits once the workers stop
         return 0;
     }
+    joinWorkers();
 
     // Remove backing store
     removeBackingStore();
@@ -233,10 +345,9 @@ int set(char *var, char *value[], int value_size) {
 }
 
 int print(char *var) {
-    char *value = mem_get_value(var);
-    if (value) {
+    char value[MAX_USER_INPUT];
+    if (mem_read_value(var, value, sizeof(value))) {
         printf("%s\n", value);
-        free(value);
     } else {
         printf("Variable does not exist\n");
     }
@@ -244,23 +355,18 @@ int print(char *var) {
 }
 
 int echo(char *tok) {
-    int must_free = 0;
+    char value[MAX_USER_INPUT];
+    const char *text = tok;
     if (tok[0] == '$') {
-        tok++;
-        tok = mem_get_value(tok);
-        if (tok == NULL) {
-            tok = "";
-        } else {
-            must_free = 1;
+        text = value;
+        if (!mem_read_value(tok + 1, value, sizeof(value))) {
+            value[0] = '\0';
         }
     }
     //printf("Front");
-    printf("%s\n", tok);
+    printf("%s\n", text);
     //printf("Back");
 
-    if (must_free) free(tok);
-
-
     return 0;
 }
 
@@ -285,30 +391,25 @@ int ls() {
 }
 
 int my_mkdir(char *name) {
-    int must_free = 0;
+    char value[MAX_USER_INPUT];
+    const char *dir = name;
 
     debug("my_mkdir: ->%s<-\n", name);
 
     if (name[0] == '$') {
-        ++name;
-        name = mem_get_value(name);
-        debug("  lookup: %s\n", name ? name : "(NULL)");
-        if (name) {
-            must_free = 1;
-        }
+        dir = mem_read_value(name + 1, value, sizeof(value)) ? value : NULL;
+        debug("  lookup: %s\n", dir ? dir : "(NULL)");
     }
-    if (!name || !str_isalphanum(name)) {
-        if (must_free) free(name);
+    if (!dir || !str_isalphanum(dir)) {
         return badcommandMkdir();
     }
 
-    int result = mkdir(name, 0777);
+    int result = mkdir(dir, 0777);
 
     if (result) {
         perror("Something went wrong in my_mkdir");
     }
 
-    if (must_free) free(name);
     return 0;
 }
 
@@ -329,6 +430,139 @@ int cd(char *path) {
     return 0;
 }
 
+// Select the page replacement policy, or show it and the fault counters
+int pagepolicy(char *name) {
+    if (name == NULL) {
+        printPagingStats();
+        return 0;
+    }
+    if (setReplacementPolicy(name) == -1) {
+        return badcommandPagePolicy();
+    }
+    return 0;
+}
+
+// Set the largest number of pages read ahead on a sequential page fault
+int prefetch(char *pages) {
+    for (char *c = pages; *c != '\0'; c++) {
+        if (!isdigit(*c)) return badcommand();
+    }
+    setPrefetchLimit(atoi(pages));
+    return 0;
+}
+
+// Turn working set load control on or off, or show its counters
+int loadcontrol(char *mode) {
+    if (mode == NULL) {
+        printLoadControlStats();
+    } else if (strcmp(mode, "on") == 0) {
+        setLoadControl(1);
+    } else if (strcmp(mode, "off") == 0) {
+        setLoadControl(0);
+    } else {
+        return badcommand();
+    }
+    return 0;
+}
+
+// Select how frames are divided among processes, or show the quotas
+int quota(char *mode) {
+    if (mode == NULL) {
+        printFrameQuotas();
+        return 0;
+    }
+    if (setFrameQuotaMode(mode) == -1) {
+        return badcommand();
+    }
+    return 0;
+}
+
+// Set the capacity of the compressed swap cache, or show its statistics
+int swapcache(char *bytes) {
+    if (bytes == NULL) {
+        printSwapCacheStats();
+        return 0;
+    }
+    for (char *c = bytes; *c != '\0'; c++) {
+        if (!isdigit(*c)) return badcommand();
+    }
+    setSwapCacheCapacity(atoi(bytes));
+    return 0;
+}
+
+// Choose synchronous or asynchronous page-in, or show how often RR waited
+int pagein(char *mode) {
+    if (mode == NULL) {
+        printPageInStats();
+    } else if (strcmp(mode, "sync") == 0) {
+        setAsyncPageIn(0);
+    } else if (strcmp(mode, "async") == 0) {
+        setAsyncPageIn(1);
+    } else {
+        return badcommand();
+    }
+    return 0;
+}
+
+// Set how many workers exec MT starts, or show the count and the number of
+// cores. More workers than cores are allowed but only add switching.
+int workers(char *count) {
+    if (count == NULL) {
+        printf("Workers: %d; Cores: %ld\n", workerCount, sysconf(_SC_NPROCESSORS_ONLN));
+        return 0;
+    }
+    if (waitForWorkers() == -1) return badcommand();
+    for (char *c = count; *c != '\0'; c++) {
+        if (!isdigit(*c)) return badcommand();
+    }
+    int n = atoi(count);
+    if (n < 1 || n > MAX_WORKERS) return badcommand();
+    workerCount = n;
+    return 0;
+}
+
+// Choose how MT workers share ready processes, or show the choice
+int readyqueue(char *backend) {
+    if (backend == NULL) {
+        printReadyQueueBackend();
+        return 0;
+    }
+    if (waitForWorkers() == -1) return badcommand();
+    if (setReadyQueueBackend(backend) == -1) {
+        return badcommand();
+    }
+    return 0;
+}
+
+// Resize the frame store, the frame size or the variable store, or show the sizes
+int resize(char *store, char *size) {
+    if (store == NULL) {
+        printf("Frame Store Size = %d; Frame Size = %d; Variable Store Size = %d\n",
+               frameStoreSize, frameSize, variableStoreSize);
+        return 0;
+    }
+    // Workers read frames and page tables without holding a lock
+    if (waitForWorkers() == -1) return badcommandResize();
+    for (char *c = size; *c != '\0'; c++) {
+        if (!isdigit(*c)) return badcommandResize();
+    }
+
+    int result;
+    if (strcmp(store, "framestore") == 0) {
+        result = resizeFrameStore(atoi(size));
+    } else if (strcmp(store, "framesize") == 0) {
+        result = resizeFrameSize(atoi(size));
+    } else if (strcmp(store, "varstore") == 0) {
+        result = resizeVariableStore(atoi(size));
+    } else {
+        result = -1;
+    }
+    if (result == -1) {
+        return badcommandResize();
+    }
+    return 0;
+}
+
 // Handle "run" command
 int run(char *script) {
     // Create a new PCB
@@ -350,101 +584,111 @@ int run(char *script) {
     return 0;
 }
 
-int exec(char *prog1, char *prog2, char *prog3, char *policy, int background, int multithread) {
-    // Create PCBs for programs
-    struct PCB *pcb1 = NULL, *pcb2 = NULL, *pcb3 = NULL;
+// Run the ready queue on a new pool of workers running the given scheduler
+static void runMultithreaded(void (*scheduler)()) {
+    if (!multithreadEnabled) {
+        multithreadEnabled = 1;
+        pthread_mutex_init(&readyQueueMutex, NULL);
+    }
+    startWorkers(scheduler);
+    if (quitRequested) {
+        exit(0);
+    }
+}
 
-    if (prog1) {
-        pcb1 = createPCB(0, 0);
-        int result = loadScript(prog1, pcb1);
-        if (result == -1) {
-            printf("Error: Could not load %s\n", prog1);
-            destroyPCB(pcb1);
-            return -1;
-        }
+int exec(char **progs, int progCount, char *policy, int background, int multithread) {
+    if (isWorkerThread()) {
+        multithread = 0;  // A script's own exec runs on the worker running the script
+    } else {
+        // Let the workers of an earlier MT exec finish its processes first, so
+        // neither exec's processes are run by the other's scheduler
+        waitForWorkers();
     }
 
-    if (prog2) {
-        pcb2 = createPCB(0, 0);
-        int result = loadScript(prog2, pcb2);
-        if (result == -1) {
-            printf("Error: Could not load %s\n", prog2);
-            destroyPCB(pcb2);
-            return -1;
-        }
+    // Create PCBs for programs in order, then load their scripts together
+    struct PCB **pcbs = (struct PCB **)malloc(sizeof(struct PCB *) * progCount);
+    for (int i = 0; i < progCount; i++) {
+        pcbs[i] = createPCB(0, 0);
     }
 
-    if (prog3) {
-        pcb3 = createPCB(0, 0);
-        int result = loadScript(prog3, pcb3);
-        if (result == -1) {
-            printf("Error: Could not load %s\n", prog3);
-            destroyPCB(pcb3);
-            return -1;
+    int failed = loadScripts(progs, pcbs, progCount);
+    if (failed != -1) {
+        printf("Error: Could not load %s\n", progs[failed]);
+        for (int i = 0; i < progCount; i++) {
+            if (i < failed) {
+                waitForScript(pcbs[i]);  // Let a streaming load finish before freeing its lines
+            }
+            destroyPCB(pcbs[i]);
         }
+        free(pcbs);
+        return -1;
     }
 
     // Schedule programs according to policy
     if (strcmp(policy, "FCFS") == 0) {
-        if (pcb1) enqueue(pcb1);
-        if (pcb2) enqueue(pcb2);
-        if (pcb3) enqueue(pcb3);
+        for (int i = 0; i < progCount; i++) {
+            enqueue(pcbs[i]);
+        }
+        free(pcbs);
 
-        runScheduler();  // Run in foreground
+        if (multithread) {
+            runMultithreaded(runScheduler);  // Workers take processes in arrival order
+        } else {
+            runScheduler();  // Run in foreground
+        }
 
     } else if (strcmp(policy, "SJF") == 0) {
-        if (pcb1) enqueueSJF(pcb1);  // SJF - Sort based on script length
-        if (pcb2) enqueueSJF(pcb2);
-        if (pcb3) enqueueSJF(pcb3);
+        // SJF needs full script lengths; wait for any still being streamed in
+        for (int i = 0; i < progCount; i++) {
+            waitForScript(pcbs[i]);
+        }
+        for (int i = 0; i < progCount; i++) {
+            enqueueSJF(pcbs[i]);  // SJF - Sort based on script length
+        }
+        free(pcbs);
 
-        runScheduler();
+        if (multithread) {
+            runMultithreaded(runScheduler);  // Workers always take the shortest job left
+        } else {
+            runScheduler();
+        }
 
     } else if (strcmp(policy, "RR") == 0) {
-        if (pcb1) enqueue(pcb1);
-        if (pcb2) enqueue(pcb2);
-        if (pcb3) enqueue(pcb3);
+        for (int i = 0; i < progCount; i++) {
+            enqueue(pcbs[i]);
+        }
+        free(pcbs);
 
         if (multithread) {
-            if (!multithreadEnabled) {
-                multithreadEnabled = 1;
-                pthread_mutex_init(&readyQueueMutex, NULL);
-                for (int i = 0; i < NUM_THREADS; i++) {
-                    pthread_create(&workerThreads[i], NULL, (void *(*)(void *))runSchedulerRR, NULL);
-                }
-                if (quitRequested) {
-                    exit(0);
-                }
-            }
-        }
-        else {
+            runMultithreaded(runSchedulerRR);
+        } else {
             runSchedulerRR();
         }
 
     } else if (strcmp(policy, "AGING") == 0) {
-        if (pcb1) enqueueSJFAging(pcb1);
-        if (pcb2) enqueueSJFAging(pcb2);
-        if (pcb3) enqueueSJFAging(pcb3);
+        for (int i = 0; i < progCount; i++) {
+            waitForScript(pcbs[i]);
+        }
+        for (int i = 0; i < progCount; i++) {
+            enqueueSJFAging(pcbs[i]);
+        }
+        free(pcbs);
 
-        runSchedulerSJFwithAging();
+        if (multithread) {
+            runMultithreaded(runSchedulerSJFwithAging);
+        } else {
+            runSchedulerSJFwithAging();
+        }
 
     } else if (strcmp(policy, "RR30") == 0) {
-        if (pcb1) enqueue(pcb1);
-        if (pcb2) enqueue(pcb2);
-        if (pcb3) enqueue(pcb3);
+        for (int i = 0; i < progCount; i++) {
+            enqueue(pcbs[i]);
+        }
+        free(pcbs);
 
         if (multithread) {
-            if (!multithreadEnabled) {
-                multithreadEnabled = 1;
-                pthread_mutex_init(&readyQueueMutex, NULL);
-                for (int i = 0; i < NUM_THREADS; i++) {
-                    pthread_create(&workerThreads[i], NULL, (void *(*)(void *))runSchedulerRR30, NULL);
-                }
-                if (quitRequested) {
-                    exit(0);
-                }
-            }
-        }
-        else {
+            runMultithreaded(runSchedulerRR30);
+        } else {
             runSchedulerRR30();
         }
     }
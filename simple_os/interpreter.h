@@ -2,9 +2,10 @@ int interpreter(char *command_args[], int args_size);
 int help();
 int quit();
 #include <pthread.h>
-#define NUM_THREADS 2
+#define MAX_WORKERS 64
 
-extern pthread_t workerThreads[NUM_THREADS];  // Array to hold thread IDs
+extern pthread_t workerThreads[MAX_WORKERS];  // Array to hold thread IDs
+extern int workerCount;  // Number of MT workers to start
 extern pthread_mutex_t readyQueueMutex;  // Mutex to control access to the ready queue
 extern int multithreadEnabled;  // Flag to indicate if multithreading is enabled
 extern int quitRequested;
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Contention benchmark: per-instruction cost of MT RR as the number of workers
+# grows, for each ready queue backend (see the readyqueue command). Like
+# scalebench.sh, every script is the same silent `set` line repeated and
+# pages are 300 lines, so the workers spend their time dispatching, not paging.
+#
+# Each configuration is run with a short and a long script, best of three
+# runs each; the difference divided by the extra instructions executed is the
+# cost of one instruction, free of the load and start-up time both runs share.
+#
+# Usage: ./mtbench.sh [POLICY [WORKERS...]]
+#   e.g. ./mtbench.sh RR 2 4 8 16
+
+POLICY=${1:-RR}
+[ $# -gt 0 ] && shift
+WORKERS=${*:-2 4 8 16}
+BACKENDS="shared deques lockfree"
+PROCESSES=1000
+SHORT=12
+LONG=240
+RUNS=3
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+HERE=$(cd "$(dirname "$0")" && pwd)
+
+${CC:-gcc} -O2 -D FRAME_STORE_SIZE=3000 -D VARIABLE_STORE_SIZE=10 -o "$WORK/mysh" \
+    "$HERE"/shell.c "$HERE"/interpreter.c "$HERE"/shellmemory.c \
+    "$HERE"/pcb.c "$HERE"/scheduler.c "$HERE"/compress.c -lpthread || exit 1
+cd "$WORK" || exit 1
+
+# Write a script of n lines
+script() {
+    yes "set x 1" | head -n "$2" > "$1"
+}
+
+# Fewest milliseconds, over a few runs, to run every process on the workers
+run() {
+    i=0; while [ $i -lt $PROCESSES ]; do echo "$3"; i=$((i + 1)); done > manifest
+    printf "resize framesize 300\nreadyqueue %s\nworkers %s\nexec @manifest %s MT\n" \
+        "$1" "$2" "$POLICY" > input
+    best=
+    r=0; while [ $r -lt $RUNS ]; do
+        begin=$(date +%s%N)
+        ./mysh < input > /dev/null
+        end=$(date +%s%N)
+        ms=$(((end - begin) / 1000000))
+        if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then best=$ms; fi
+        r=$((r + 1))
+    done
+    echo "$best"
+}
+
+echo "$PROCESSES processes, $(nproc) cores"
+printf "%-10s %8s %12s %12s %16s\n" backend workers short_ms long_ms ns/instruction
+script short $SHORT
+script long $LONG
+for backend in $BACKENDS; do
+    for n in $WORKERS; do
+        shortMs=$(run "$backend" "$n" short)
+        longMs=$(run "$backend" "$n" long)
+        perInstruction=$(((longMs - shortMs) * 1000000 / (PROCESSES * (LONG - SHORT))))
+        printf "%-10s %8s %12s %12s %16s\n" "$backend" "$n" "$shortMs" "$longMs" "$perInstruction"
+    done
+done
@@ -1,40 +1,147 @@
 // pcb.c
 #include "pcb.h"
 #include <stdlib.h>
+#include <string.h>
 #include "shellmemory.h"
 
 // Global PID counter
 static int pidCounter = 0;
 
-// Create a new PCB
+// All PCBs that have been created and not yet destroyed
+static struct PCB *livePCBs = NULL;
+
+// PCBs are carved from slabs and recycled through a free list linked by their
+// next field, so spawning or tearing down a process pops or pushes one pointer
+#define PCB_SLAB_SIZE 64
+static struct PCB *freePCBs = NULL;
+
+// Page table blocks come in power-of-two page counts. A block holds a PCB's
+// sharer links, page table and last-use times back to back, and freed blocks
+// wait on their class's list for the next PCB of that size.
+#define PAGE_TABLE_CLASSES 32
+static void *freePageTableBlocks[PAGE_TABLE_CLASSES];
+
+// The caller holds the paging lock, as for the rest of PCB bookkeeping
+static struct PCB *allocPCB() {
+    if (freePCBs == NULL) {
+        struct PCB *slab = (struct PCB *)malloc(sizeof(struct PCB) * PCB_SLAB_SIZE);
+        for (int i = PCB_SLAB_SIZE - 1; i >= 0; i--) {
+            slab[i].next = freePCBs;
+            freePCBs = &slab[i];
+        }
+    }
+    struct PCB *pcb = freePCBs;
+    freePCBs = pcb->next;
+    return pcb;
+}
+
+// Give a PCB page tables for the given number of pages, all unmapped. The
+// caller holds the paging lock.
+void allocPageTables(struct PCB *pcb, int pages) {
+    int pageClass = 0;
+    while ((1 << pageClass) < pages) {
+        pageClass++;
+    }
+    int capacity = 1 << pageClass;
+    void *block = freePageTableBlocks[pageClass];
+    if (block != NULL) {
+        freePageTableBlocks[pageClass] = *(void **)block;
+    } else {
+        block = malloc(capacity * (sizeof(struct PageSharer) + 2 * sizeof(int)));
+    }
+
+    pcb->pageTableClass = pageClass;
+    pcb->pageSharers = (struct PageSharer *)block;
+    pcb->pageTable = (int *)(pcb->pageSharers + capacity);
+    pcb->pageLastUse = pcb->pageTable + capacity;
+    memset(pcb->pageSharers, 0, sizeof(struct PageSharer) * pages);
+    memset(pcb->pageLastUse, 0, sizeof(int) * pages);
+    for (int i = 0; i < pages; i++) {
+        pcb->pageTable[i] = -1;  // -1 indicates the page is not loaded
+    }
+}
+
+// Return a PCB's page tables to their size class. The caller holds the paging lock.
+void freePageTables(struct PCB *pcb) {
+    if (pcb->pageSharers == NULL) {
+        return;
+    }
+    *(void **)pcb->pageSharers = freePageTableBlocks[pcb->pageTableClass];
+    freePageTableBlocks[pcb->pageTableClass] = pcb->pageSharers;
+    pcb->pageTable = NULL;
+    pcb->pageSharers = NULL;
+    pcb->pageLastUse = NULL;
+}
+
+// Create a new PCB. Its page tables are allocated once its script's length is
+// known (see loadScript).
 struct PCB* createPCB(int start, int length) {
-    struct PCB *pcb = (struct PCB*) malloc(sizeof(struct PCB));
+    lockPaging();  // MT workers create and destroy PCBs too
+    struct PCB *pcb = allocPCB();
     pcb->pid = pidCounter++;  // Assign unique PID
     pcb->start = start;       // Start index of the script in script memory
     pcb->length = length;     // Total number of lines in the script
+    pcb->lengthFinal = 1;
+    pcb->loading = 0;
+    pcb->linesLoaded = length;
     pcb->pc = 0;              // Program counter, starting at 0
     pcb->jobLengthScore = length;
     pcb->next = NULL;
 
+    // Link into the list of live PCBs
+    pcb->livePrev = NULL;
+    pcb->liveNext = livePCBs;
+    if (livePCBs != NULL) {
+        livePCBs->livePrev = pcb;
+    }
+    livePCBs = pcb;
+    unlockPaging();
+
     // Initialize paging related information
-    int totalPages = (length + FRAME_SIZE - 1) / FRAME_SIZE; // Calculate total number of pages
-    pcb->pages_max = totalPages;
+    pcb->pages_max = (length + frameSize - 1) / frameSize; // Calculate total number of pages
     pcb->pages_loaded = 0;
-    pcb->pageTable = (int *)malloc(sizeof(int) * totalPages);
-    for (int i = 0; i < totalPages; i++) {
-        pcb->pageTable[i] = -1;  // -1 indicates the page is not loaded
-    }
+    pcb->privateFrames = 0;
+    pcb->lastFaultPage = -1;
+    pcb->prefetchWindow = 1;
+    pcb->pageTable = NULL;
+    pcb->pageSharers = NULL;
+    pcb->pageLastUse = NULL;
+    pcb->virtualTime = 0;
+    pcb->frameQuota = 0;
+    pcb->lastFaultTime = 0;
+    pcb->pendingPage = -1;
+    pcb->workingSet = 0;
+    pcb->workingSetLine = -1;
+    pcb->pinnedFrame = -1;
 
     return pcb;
 }
 
-// Destroy PCB, free memory
+// Destroy PCB, returning it and its page tables to their pools
 void destroyPCB(struct PCB *pcb) {
     if (pcb != NULL) {
-        if (pcb->pageTable != NULL) {
-            free(pcb->pageTable);
-            pcb->pageTable = NULL;
+        lockPaging();
+        releasePCBFrames(pcb);  // Frames may outlive the PCB; forget the owner
+        releaseScriptLines(pcb->start, pcb->length);
+        freePageTables(pcb);
+
+        // Unlink from the list of live PCBs
+        if (pcb->livePrev != NULL) {
+            pcb->livePrev->liveNext = pcb->liveNext;
+        } else {
+            livePCBs = pcb->liveNext;
         }
-        free(pcb);
+        if (pcb->liveNext != NULL) {
+            pcb->liveNext->livePrev = pcb->livePrev;
+        }
+        pcb->next = freePCBs;
+        freePCBs = pcb;
+        updateFrameQuotas();  // Share its frames among the others
+        unlockPaging();
     }
 }
+
+// First PCB in the list of live PCBs; follow liveNext for the rest
+struct PCB *getLivePCBs() {
+    return livePCBs;
+}
@@ -3,20 +3,51 @@
 #ifndef PCB_H
 #define PCB_H
 
+// Neighbouring PCB pages mapping the same frame (see the inverted page table in shellmemory.c)
+struct PageSharer {
+    struct PCB *pcb;      // Next sharer
+    int page;
+    struct PCB *prevPcb;  // Previous sharer, NULL for the frame's owner
+    int prevPage;
+};
+
 struct PCB {
     int pid;              // Process ID
     int start;            // Start index of the script in script memory
-    int length;           // Total number of lines in the script
+    int length;           // Total number of lines in the script (loaded so far while streaming)
+    int lengthFinal;      // 0 while the script is still being streamed in
+    int loading;          // Set until the streaming loader has indexed every line
+    int linesLoaded;      // Lines indexed so far by the streaming loader
     int pc;               // Program counter, indicating the current executing line
     int jobLengthScore;   // Job length score for scheduling
     struct PCB *next;     // Pointer to the next PCB (for the ready queue)
+    long heapKey;         // Key in the SJF/AGING ready heap (AGING adds the aging epoch)
+    long heapOrder;       // Enqueue order in the ready heap, breaking ties between equal keys
+    struct PCB *liveNext; // Links in the list of all PCBs not yet destroyed
+    struct PCB *livePrev;
 
     int *pageTable;       // Page table, mapping pages to frames
+    struct PageSharer *pageSharers;  // Per page, the next sharer of its frame (heads the page table block)
+    int pageTableClass;   // Size class of the page table block (see allocPageTables)
     int pages_max;        // Total number of pages
     int pages_loaded;     // Number of pages loaded
+    int privateFrames;    // Resident frames mapped by this PCB alone (local replacement victims)
+    int lastFaultPage;    // Last page brought in by a fault or its read-ahead
+    int prefetchWindow;   // Pages to read ahead on the next sequential fault
+    int *pageLastUse;     // Per page, virtual time of its last reference (0 if never)
+    int virtualTime;      // Instructions fetched by this process
+    int frameQuota;       // Most resident pages under a frame quota mode
+    int lastFaultTime;    // Virtual time of the last page fault (for PFF)
+    int pendingPage;      // Page being read in asynchronously, -1 if none
+    int workingSet;       // Frames of its own counted in the ready working set
+    int workingSetLine;   // First line of the missing page counted there, -1 if none
+    int pinnedFrame;      // Frame pinned by the MT worker running the PCB, -1 if none
 };
 
 struct PCB* createPCB(int start, int length);
 void destroyPCB(struct PCB *pcb);
+void allocPageTables(struct PCB *pcb, int pages);
+void freePageTables(struct PCB *pcb);
+struct PCB *getLivePCBs();
 
 #endif
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Scale benchmark: per-instruction scheduling cost as the number of processes
+# grows. Every script is the same silent `set` line repeated and pages are 300
+# lines, so processes share a handful of frames and fault once per 300 lines;
+# the time measured is the scheduler's, not the pager's. Shell settings are
+# the defaults: load control is on, and since the copies share their frames
+# every process stays ready.
+#
+# Each count is run with a short and a long script; the difference divided by
+# the extra instructions executed is the cost of one instruction, free of the
+# load and start-up time both runs share. Smaller counts repeat the exec so
+# every count runs at least about the same number of extra instructions. Both
+# scripts stay under the size at which loads are streamed.
+#
+# Usage: ./scalebench.sh [POLICY [COUNT...]]
+#   e.g. ./scalebench.sh RR 3 10 100 1000 10000
+
+POLICY=${1:-RR}
+[ $# -gt 0 ] && shift
+COUNTS=${*:-3 10 100 1000 10000}
+SHORT=12
+LONG=240
+EXTRA=1000000  # Extra instructions the long runs execute at each count
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+HERE=$(cd "$(dirname "$0")" && pwd)
+
+${CC:-gcc} -O2 -D FRAME_STORE_SIZE=3000 -D VARIABLE_STORE_SIZE=10 -o "$WORK/mysh" \
+    "$HERE"/shell.c "$HERE"/interpreter.c "$HERE"/shellmemory.c \
+    "$HERE"/pcb.c "$HERE"/scheduler.c "$HERE"/compress.c -lpthread || exit 1
+cd "$WORK" || exit 1
+
+# Write a script of n lines
+script() {
+    yes "set x 1" | head -n "$2" > "$1"
+}
+
+# Milliseconds to run n copies of a script, as many times as asked
+run() {
+    i=0; while [ $i -lt "$1" ]; do echo "$2"; i=$((i + 1)); done > manifest
+    { echo "resize framesize 300"; yes "exec @manifest $POLICY" | head -n "$3"; } > input
+    begin=$(date +%s%N)
+    ./mysh < input > /dev/null
+    end=$(date +%s%N)
+    echo $(((end - begin) / 1000000))
+}
+
+printf "%-10s %12s %12s %16s\n" processes short_ms long_ms ns/instruction
+script short $SHORT
+script long $LONG
+for n in $COUNTS; do
+    repeat=$((EXTRA / (n * (LONG - SHORT))))
+    [ "$repeat" -lt 1 ] && repeat=1
+    shortMs=$(run "$n" short "$repeat")
+    longMs=$(run "$n" long "$repeat")
+    perInstruction=$(((longMs - shortMs) * 1000000 / (repeat * n * (LONG - SHORT))))
+    printf "%-10s %12s %12s %16s\n" "$n" "$shortMs" "$longMs" "$perInstruction"
+done
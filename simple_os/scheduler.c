@@ -8,19 +8,107 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <string.h>
 
 // Head and tail of the ready queue
 static struct PCB *readyQueueHead = NULL;
 static struct PCB *readyQueueTail = NULL;
-void ageReadyQueue(struct PCB *currentProcess);
+
+// SJF and AGING keep their ready processes in a binary min-heap instead, keyed
+// by job length or score and then by enqueue order, so processes with equal
+// keys leave in the order the sorted list used to give them
+static struct PCB **readyHeap = NULL;
+static int readyHeapSize = 0;
+static int readyHeapCapacity = 0;
+static long readyHeapOrder = 0;  // Enqueue counter breaking ties between equal keys
+
+// Processes in the list and heap, kept atomically so emptiness checks need no lock
+static int readyCount = 0;
+
+// MT workers each own a run deque: a worker re-enqueues the processes it runs
+// on its own deque, so dispatch takes only that deque's lock. New processes
+// still arrive on the shared list; workers drain it first, and a worker whose
+// deque runs dry steals from the others.
+struct RunDeque {
+    pthread_mutex_t lock;
+    struct PCB *head;
+    struct PCB *tail;
+    int size;  // Read atomically to skip empty deques without locking them
+};
+static struct RunDeque runDeques[MAX_WORKERS];
+static int runDequeCount = 0;             // Deques set up by startWorkers
+static int workerIds[MAX_WORKERS];        // Start argument of each worker
+static void (*workerScheduler)() = NULL;  // Scheduler loop the workers run
+static int startedWorkers = 0;            // Workers started and not yet joined
+static __thread int workerId = -1;        // This thread's deque, -1 outside the workers
+
+// How MT workers share ready processes: one locked list, a run deque each, or
+// one lock-free ring
+#define READY_SHARED 0
+#define READY_DEQUES 1
+#define READY_LOCKFREE 2
+static int readyQueueBackend = READY_DEQUES;
+static const char *readyQueueBackendNames[] = {"shared", "deques", "lockfree"};
+
+// The lock-free backend is a bounded multi-producer, multi-consumer ring
+// (Vyukov's): a thread claims a cell by advancing the tail or head with a
+// compare-and-swap, and each cell's sequence number tells whether it is free
+// or filled for the current lap. A full ring overflows onto the shared list.
+struct RingCell {
+    long sequence;
+    struct PCB *pcb;
+};
+static struct RingCell *readyRing = NULL;
+static long readyRingMask = 0;
+static long readyRingHead = 0;  // Next cell to dequeue from
+static long readyRingTail = 0;  // Next cell to enqueue into
+
+// AGING ages lazily: every waiting process loses one point of score per
+// instruction run, so rather than lowering each score the scheduler counts
+// instructions here. A process enters the heap keyed by its score plus the
+// count at that moment, and its aged score is that key less the count now.
+static long agingEpoch = 0;
+
+void ageReadyQueue();
+static int agedScore(struct PCB *pcb);
+static struct PCB *dequeueSJFAging();
 struct PCB* findLowestScoreJob(struct PCB *currentProcess);
-// Global PCB linked list head, used for updating page tables
-struct PCB *pcbListHead = NULL;  // When creating a PCB, it needs to be added to this linked list
 
 // Mutex and multithreading flag (declared in interpreter.c)
 extern pthread_mutex_t readyQueueMutex;
 extern int multithreadEnabled;
 
+// Load control for RR and RR30: processes suspended because the working sets
+// of the ready processes did not fit in the frame store, in suspension order
+static struct PCB *suspendedQueueHead = NULL;
+static struct PCB *suspendedQueueTail = NULL;
+static int loadControlEnabled = 1;
+static int suspendCount = 0;
+static int resumeCount = 0;
+
+// Frames the working sets of the processes on the ready list need, counted as
+// each is enqueued, so load control need not walk the list every slice
+static int readyWorkingSet = 0;
+
+// Turn load control on or off
+void setLoadControl(int enabled) {
+    loadControlEnabled = enabled;
+}
+
+// Print the load control state and counters
+void printLoadControlStats() {
+    printf("Load control: %s; Suspended: %d; Resumed: %d\n",
+           loadControlEnabled ? "on" : "off", suspendCount, resumeCount);
+}
+
+// Asynchronous page-in for RR and RR30: processes waiting for a page from the
+// loader thread, in the order they faulted
+static struct PCB *blockedQueueHead = NULL;
+static struct PCB *blockedQueueTail = NULL;
+
+static void pushRunDeque(struct RunDeque *deque, struct PCB *pcb);
+static int pushReadyRing(struct PCB *pcb);
+
 // Lock the ready queue
 void lockReadyQueue() {
     if (multithreadEnabled) {
@@ -37,7 +125,18 @@ void unlockReadyQueue() {
 
 // Enqueue a process (PCB) to the ready queue
 void enqueue(struct PCB *process) {
+    if (workerId != -1 && runDequeCount > 0) {
+        pushRunDeque(&runDeques[workerId], process);
+        return;
+    }
+    if (readyRing != NULL && pushReadyRing(process)) {
+        return;
+    }
+    // MT workers skip load control and would read other processes' frames
+    int workingSet = multithreadEnabled ? 0 : claimWorkingSet(process);
     lockReadyQueue();
+    __atomic_add_fetch(&readyCount, 1, __ATOMIC_SEQ_CST);
+    readyWorkingSet += workingSet;
     if (readyQueueHead == NULL) {
         readyQueueHead = process;
         readyQueueTail = process;
@@ -48,14 +147,270 @@ void enqueue(struct PCB *process) {
     unlockReadyQueue();
 }
 
-// Dequeue a process (PCB) from the ready queue
-struct PCB *dequeue() {
+// Whether a heap entry must leave before another
+static int heapBefore(struct PCB *a, struct PCB *b) {
+    return a->heapKey < b->heapKey || (a->heapKey == b->heapKey && a->heapOrder < b->heapOrder);
+}
+
+// Add a process to the ready heap under the given key. Caller holds the ready
+// queue lock.
+static void heapPush(struct PCB *pcb, long key) {
+    if (readyHeapSize == readyHeapCapacity) {
+        int capacity = readyHeapCapacity == 0 ? 64 : readyHeapCapacity * 2;
+        struct PCB **heap = realloc(readyHeap, capacity * sizeof(struct PCB *));
+        if (heap == NULL) {
+            printf("Error: Out of memory for the ready queue\n");
+            exit(1);
+        }
+        readyHeap = heap;
+        readyHeapCapacity = capacity;
+    }
+    pcb->heapKey = key;
+    pcb->heapOrder = readyHeapOrder++;
+    __atomic_add_fetch(&readyCount, 1, __ATOMIC_SEQ_CST);
+    pcb->next = NULL;
+
+    // Sift up
+    int i = readyHeapSize++;
+    while (i > 0 && heapBefore(pcb, readyHeap[(i - 1) / 2])) {
+        readyHeap[i] = readyHeap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    readyHeap[i] = pcb;
+}
+
+// Remove and return the first process of the ready heap. Caller holds the
+// ready queue lock and has checked the heap is not empty.
+static struct PCB *heapPop() {
+    struct PCB *top = readyHeap[0];
+    struct PCB *last = readyHeap[--readyHeapSize];
+    __atomic_sub_fetch(&readyCount, 1, __ATOMIC_SEQ_CST);
+
+    // Sift the last entry down from the root
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= readyHeapSize) {
+            break;
+        }
+        if (child + 1 < readyHeapSize && heapBefore(readyHeap[child + 1], readyHeap[child])) {
+            child++;
+        }
+        if (!heapBefore(readyHeap[child], last)) {
+            break;
+        }
+        readyHeap[i] = readyHeap[child];
+        i = child;
+    }
+    if (readyHeapSize > 0) {
+        readyHeap[i] = last;
+    }
+    return top;
+}
+
+// Append a process to a worker's run deque
+static void pushRunDeque(struct RunDeque *deque, struct PCB *pcb) {
+    pcb->next = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head == NULL) {
+        deque->head = pcb;
+    } else {
+        deque->tail->next = pcb;
+    }
+    deque->tail = pcb;
+    __atomic_add_fetch(&deque->size, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// Take the process at the head of a run deque, the one that has waited
+// longest. Owner and thieves both take from the head, so a stolen process is
+// never one that has just run. Returns NULL if the deque is empty.
+static struct PCB *popRunDeque(struct RunDeque *deque) {
+    if (__atomic_load_n(&deque->size, __ATOMIC_SEQ_CST) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&deque->lock);
+    struct PCB *pcb = deque->head;
+    if (pcb != NULL) {
+        deque->head = pcb->next;
+        if (deque->head == NULL) {
+            deque->tail = NULL;
+        }
+        pcb->next = NULL;
+        __atomic_sub_fetch(&deque->size, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return pcb;
+}
+
+// Add a process to the lock-free ring. Returns 0 if the ring is full.
+static int pushReadyRing(struct PCB *pcb) {
+    struct RingCell *cell;
+    long position = __atomic_load_n(&readyRingTail, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &readyRing[position & readyRingMask];
+        long lap = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - position;
+        if (lap == 0) {
+            // The cell is free; claim it, or retry from the tail another thread moved
+            if (__atomic_compare_exchange_n(&readyRingTail, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lap < 0) {
+            return 0;  // Still filled from the previous lap: the ring is full
+        } else {
+            position = __atomic_load_n(&readyRingTail, __ATOMIC_RELAXED);
+        }
+    }
+    pcb->next = NULL;
+    cell->pcb = pcb;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);  // Publish it
+    return 1;
+}
+
+// Take the oldest process from the lock-free ring, or NULL if it is empty
+static struct PCB *popReadyRing() {
+    struct RingCell *cell;
+    long position = __atomic_load_n(&readyRingHead, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &readyRing[position & readyRingMask];
+        long lap = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (position + 1);
+        if (lap == 0) {
+            if (__atomic_compare_exchange_n(&readyRingHead, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (lap < 0) {
+            return NULL;  // Not filled yet: the ring is empty
+        } else {
+            position = __atomic_load_n(&readyRingHead, __ATOMIC_RELAXED);
+        }
+    }
+    struct PCB *pcb = cell->pcb;
+    // Free the cell for the next lap
+    __atomic_store_n(&cell->sequence, position + readyRingMask + 1, __ATOMIC_RELEASE);
+    return pcb;
+}
+
+// Choose how MT workers share ready processes. Returns -1 for an unknown name.
+int setReadyQueueBackend(const char *name) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, readyQueueBackendNames[i]) == 0) {
+            readyQueueBackend = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Print the ready queue backend MT workers use
+void printReadyQueueBackend() {
+    printf("Ready queue: %s\n", readyQueueBackendNames[readyQueueBackend]);
+}
+
+// Whether the ready queue, counting every worker's run deque, is empty
+int readyQueueEmpty() {
+    if (__atomic_load_n(&readyCount, __ATOMIC_SEQ_CST) > 0) {
+        return 0;
+    }
+    if (readyRing != NULL
+        && __atomic_load_n(&readyRingTail, __ATOMIC_SEQ_CST) != __atomic_load_n(&readyRingHead, __ATOMIC_SEQ_CST)) {
+        return 0;
+    }
+    for (int i = 0; i < runDequeCount; i++) {
+        if (__atomic_load_n(&runDeques[i].size, __ATOMIC_SEQ_CST) > 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Worker thread body: claim a run deque, then run the scheduler loop
+static void *runWorker(void *arg) {
+    workerId = *(int *)arg;
+    workerScheduler();
+    return NULL;
+}
+
+// Start the MT workers running the given scheduler loop, with an empty run
+// deque each or the lock-free ring, as the backend asks
+void startWorkers(void (*scheduler)()) {
+    workerScheduler = scheduler;
+    for (int i = 0; i < workerCount; i++) {
+        workerIds[i] = i;
+    }
+    if (readyQueueBackend == READY_DEQUES) {
+        for (int i = 0; i < workerCount; i++) {
+            pthread_mutex_init(&runDeques[i].lock, NULL);
+            runDeques[i].head = NULL;
+            runDeques[i].tail = NULL;
+            runDeques[i].size = 0;
+        }
+        runDequeCount = workerCount;
+    } else if (readyQueueBackend == READY_LOCKFREE) {
+        // Room for twice the processes waiting now; later ones may overflow
+        long capacity = 1024;
+        while (capacity < 2L * __atomic_load_n(&readyCount, __ATOMIC_SEQ_CST)) {
+            capacity *= 2;
+        }
+        readyRing = (struct RingCell *)malloc(sizeof(struct RingCell) * capacity);
+        for (long i = 0; i < capacity; i++) {
+            readyRing[i].sequence = i;
+            readyRing[i].pcb = NULL;
+        }
+        readyRingMask = capacity - 1;
+    }
+    startedWorkers = workerCount;
+    for (int i = 0; i < workerCount; i++) {
+        pthread_create(&workerThreads[i], NULL, runWorker, &workerIds[i]);
+    }
+}
+
+// Whether the calling thread is an MT worker
+int isWorkerThread() {
+    return workerId != -1;
+}
+
+// This thread's worker number, -1 outside the MT workers
+int getWorkerId() {
+    return workerId;
+}
+
+// Wait for the workers to run out of processes and exit, then take down their
+// run deques or ring so the next startWorkers begins afresh
+void joinWorkers() {
+    for (int i = 0; i < startedWorkers; i++) {
+        pthread_join(workerThreads[i], NULL);
+    }
+    startedWorkers = 0;
+    for (int i = 0; i < runDequeCount; i++) {
+        pthread_mutex_destroy(&runDeques[i].lock);
+    }
+    runDequeCount = 0;
+    if (readyRing != NULL) {
+        free(readyRing);
+        readyRing = NULL;
+        readyRingMask = 0;
+        readyRingHead = 0;
+        readyRingTail = 0;
+    }
+}
+
+// Take the next process from the shared list or heap
+static struct PCB *dequeueShared() {
     lockReadyQueue();
+    if (readyHeapSize > 0) {
+        struct PCB *process = heapPop();
+        unlockReadyQueue();
+        return process;
+    }
     if (readyQueueHead == NULL) {
         unlockReadyQueue();
         return NULL;  // Queue is empty
     }
     struct PCB *process = readyQueueHead;
+    __atomic_sub_fetch(&readyCount, 1, __ATOMIC_SEQ_CST);
+    readyWorkingSet -= releaseWorkingSet(process);
     readyQueueHead = readyQueueHead->next;
     if (readyQueueHead == NULL) {
         readyQueueTail = NULL;  // Queue is now empty
@@ -65,23 +420,156 @@ struct PCB *dequeue() {
     return process;
 }
 
+// Dequeue a process (PCB) from the ready queue. New processes on the shared
+// list come first, then the lock-free ring's; with run deques an MT worker
+// takes from its own and then steals from the others in turn, starting with
+// its neighbour.
+struct PCB *dequeue() {
+    if ((runDequeCount == 0 && readyRing == NULL) || __atomic_load_n(&readyCount, __ATOMIC_SEQ_CST) > 0) {
+        struct PCB *process = dequeueShared();
+        if (process != NULL) {
+            return process;
+        }
+    }
+    if (readyRing != NULL) {
+        return popReadyRing();
+    }
+    for (int i = 0; i < runDequeCount; i++) {
+        int victim = workerId == -1 ? i : (workerId + i) % runDequeCount;
+        struct PCB *process = popRunDeque(&runDeques[victim]);
+        if (process != NULL) {
+            return process;
+        }
+    }
+    return NULL;
+}
+
+// Park a process until its pending page has been read in
+static void blockProcess(struct PCB *pcb) {
+    pcb->next = NULL;
+    if (blockedQueueHead == NULL) {
+        blockedQueueHead = pcb;
+    } else {
+        blockedQueueTail->next = pcb;
+    }
+    blockedQueueTail = pcb;
+}
+
+// Collect finished page-ins and move processes whose page has arrived back to
+// the ready queue, in the order they blocked. With wait set, block until at
+// least one page-in finishes.
+static void wakeBlocked(int wait) {
+    if (blockedQueueHead == NULL) {
+        return;
+    }
+    finishPageIns(wait);
+
+    struct PCB *prev = NULL;
+    struct PCB *pcb = blockedQueueHead;
+    while (pcb != NULL) {
+        struct PCB *next = pcb->next;
+        if (pcb->pendingPage == -1) {
+            if (prev == NULL) {
+                blockedQueueHead = next;
+            } else {
+                prev->next = next;
+            }
+            if (blockedQueueTail == pcb) {
+                blockedQueueTail = prev;
+            }
+            pcb->next = NULL;
+            enqueue(pcb);
+        } else {
+            prev = pcb;
+        }
+        pcb = next;
+    }
+}
+
+// Start a page fault for a process. Returns 1 if the page is being read in
+// asynchronously and the process has been blocked, 0 once the page is resident.
+static int faultPage(struct PCB *pcb, int pageNumber) {
+    if (isAsyncPageIn() && !multithreadEnabled && requestPageIn(pcb, pageNumber)) {
+        blockProcess(pcb);
+        return 1;
+    }
+    if (__atomic_load_n(&pcb->pageTable[pageNumber], __ATOMIC_SEQ_CST) == -1) {  // Other workers may be evicting it
+        handlePageFault(pcb, pageNumber);
+    }
+    return 0;
+}
+
+// Pin the page holding the process's next line, faulting it in first, so other
+// MT workers do not evict it while the line runs
+static void pinNextLine(struct PCB *pcb) {
+    int pageNumber = pcb->pc / frameSize;
+    int frameNumber;
+    while ((frameNumber = pinPage(pcb, pageNumber)) == -1) {
+        faultPage(pcb, pageNumber);
+    }
+    accessFrame(frameNumber);
+}
+
+// Suspend ready processes while their combined working sets exceed the frame
+// store, and resume suspended ones in order once they fit again. At least one
+// process always stays runnable, so the scheduler keeps making progress while
+// the others wait instead of evicting each other's pages every time slice.
+// Workers hold processes outside the queue, so this is skipped in MT mode.
+static void controlLoad() {
+    if (!loadControlEnabled || multithreadEnabled) {
+        return;
+    }
+
+    // Suspend from the head: its pages have waited longest and are the
+    // coldest, so its frames are the first the others can use
+    while (readyWorkingSet > frameCount && readyCount > 1) {
+        struct PCB *pcb = dequeue();
+        if (suspendedQueueHead == NULL) {
+            suspendedQueueHead = pcb;
+        } else {
+            suspendedQueueTail->next = pcb;
+        }
+        suspendedQueueTail = pcb;
+        suspendCount++;
+    }
+
+    while (suspendedQueueHead != NULL
+           && (readyCount == 0 || readyWorkingSet + estimateWorkingSet(suspendedQueueHead) <= frameCount)) {
+        struct PCB *pcb = suspendedQueueHead;
+        suspendedQueueHead = pcb->next;
+        if (suspendedQueueHead == NULL) {
+            suspendedQueueTail = NULL;
+        }
+        pcb->next = NULL;
+        enqueue(pcb);
+        resumeCount++;
+    }
+}
+
 // Run FCFS Scheduler
 void runScheduler() {
-    while (readyQueueHead != NULL) {
+    while (!readyQueueEmpty()) {
         struct PCB *currentProcess = dequeue();  // Get the next process
+        if (currentProcess == NULL) {
+            continue;  // Another MT worker took the last one
+        }
 
-        // Execute the process's instructions
-        while (currentProcess->pc < currentProcess->length) {
+        // Execute the process's instructions, waiting for lines still being streamed in
+        while (waitForLine(currentProcess)) {
+            if (multithreadEnabled) {
+                pinNextLine(currentProcess);
+            }
             char *line = getLineFromPCB(currentProcess);  // Get instruction from PCB's page table
 
             if (line == NULL) {
                 // Page not loaded or has been evicted, handle page fault
-                int pageNumber = currentProcess->pc / FRAME_SIZE;
+                int pageNumber = currentProcess->pc / frameSize;
                 handlePageFault(currentProcess, pageNumber);
 
                 // Re-fetch the instruction
                 line = getLineFromPCB(currentProcess);
                 if (line == NULL) {
+                    unpinFrame(currentProcess);
                     printf("Error: Unable to load instruction for process %d at PC %d.\n",
                            currentProcess->pid, currentProcess->pc);
                     break;
@@ -89,6 +577,7 @@ void runScheduler() {
             }
 
             parseInput(line);  // Execute instruction
+            unpinFrame(currentProcess);
             currentProcess->pc++;  // Move to the next instruction
         }
 
@@ -99,33 +588,39 @@ void runScheduler() {
 
 // Run RR Scheduler (time slice of 2)
 void runSchedulerRR() {
-    while (readyQueueHead != NULL) {
+    while (!readyQueueEmpty() || suspendedQueueHead != NULL || blockedQueueHead != NULL) {
+        // Wait for a page-in only when nothing else can run
+        wakeBlocked(readyQueueEmpty() && suspendedQueueHead == NULL);
+        controlLoad();
         struct PCB *currentProcess = dequeue();  // Get the next process
+        if (currentProcess == NULL) {
+            continue;
+        }
 
         // Execute instructions
         int timeSlice = 0;  // Initialize time slice counter
+        int yielded = 0;    // Set when the slice ends early with the process still ready
 
         while (timeSlice < 2) {  // Time slice is 2
-            if (currentProcess->pc >= currentProcess->length) {
+            if (!waitForLine(currentProcess)) {
                 break;  // Process has completed
             }
 
-            int pageNumber = currentProcess->pc / FRAME_SIZE;
-            int offset = currentProcess->pc % FRAME_SIZE;
-
-            // Check if the page is loaded
-            if (currentProcess->pageTable[pageNumber] == -1) {
-                // Handle page fault
-                handlePageFault(currentProcess, pageNumber);
-
-                // After handling the page fault, yield control
-                // Re-enqueue the current process and move on to the next process
-                enqueue(currentProcess);
+            int pageNumber = currentProcess->pc / frameSize;
+            int offset = currentProcess->pc % frameSize;
+
+            // Check if the page is loaded, pinning it so other MT workers do
+            // not evict it while the line runs
+            int frameNumber = pinPage(currentProcess, pageNumber);
+            if (frameNumber == -1) {
+                // Handle page fault; an asynchronous one blocks the process
+                if (!faultPage(currentProcess, pageNumber)) {
+                    // After handling the page fault, yield control
+                    yielded = 1;
+                }
                 break;  // Break out of the time slice loop
             }
 
-            int frameNumber = currentProcess->pageTable[pageNumber];
-
             // Update frame usage time
             accessFrame(frameNumber);
 
@@ -133,67 +628,45 @@ void runSchedulerRR() {
             char *line = getLineFromPCB(currentProcess);
             if (line == NULL) {
                 // This should not happen, but handle it gracefully
+                unpinFrame(currentProcess);
                 printf("Error: Unable to fetch instruction for process %d at PC %d.\n",
                        currentProcess->pid, currentProcess->pc);
-                // Re-enqueue the current process and move on to the next process
-                enqueue(currentProcess);
+                yielded = 1;
                 break;  // Break out of the time slice loop
             }
 
             // Execute the instruction
             parseInput(line);
+            unpinFrame(currentProcess);
 
             // Increment the program counter after successful execution
             currentProcess->pc++;
             timeSlice++;  // Increment the time slice counter
         }
 
-        // Check if the process has completed
-        if (currentProcess->pc >= currentProcess->length) {
+        // Check if the process has completed; a streamed script is only
+        // complete once its loader has finished
+        if (currentProcess->pc >= currentProcess->length && currentProcess->lengthFinal) {
             destroyPCB(currentProcess);
-        } else if (timeSlice == 2) {
-            // Process not completed and time slice expired, re-enqueue it
+        } else if (timeSlice == 2 || yielded) {
+            // Process not completed and its time slice expired or it yielded,
+            // re-enqueue it. Only now: another MT worker may run it at once.
             enqueue(currentProcess);
         }
-        // If the process was re-enqueued due to a page fault, it's already in the queue
+        // If the process was blocked due to a page fault, it's already in a queue
     }
 }
 
 // Enqueue PCB to the ready queue based on SJF strategy
 void enqueueSJF(struct PCB *pcb) {
     lockReadyQueue();
-    if (readyQueueHead == NULL) {
-        readyQueueHead = pcb;
-        readyQueueTail = pcb;
-    } else {
-        struct PCB *prev = NULL;
-        struct PCB *current = readyQueueHead;
-
-        // Sort based on script length
-        while (current != NULL && current->length <= pcb->length) {
-            prev = current;
-            current = current->next;
-        }
-
-        if (prev == NULL) {
-            // Insert at the head
-            pcb->next = readyQueueHead;
-            readyQueueHead = pcb;
-        } else {
-            // Insert in the middle or at the tail
-            pcb->next = current;
-            prev->next = pcb;
-            if (current == NULL) {
-                readyQueueTail = pcb;  // Update the tail
-            }
-        }
-    }
+    heapPush(pcb, pcb->length);  // Shortest script first
     unlockReadyQueue();
 }
 
 // Run SJF Scheduler
 void runSchedulerSJF() {
-    while (readyQueueHead != NULL) {
+    while (!readyQueueEmpty()) {
         struct PCB *currentProcess = dequeue();
 
         // Execute the process's instructions
@@ -202,7 +675,7 @@ void runSchedulerSJF() {
 
             if (line == NULL) {
                 // Page not loaded or has been evicted, handle page fault
-                int pageNumber = currentProcess->pc / FRAME_SIZE;
+                int pageNumber = currentProcess->pc / frameSize;
                 handlePageFault(currentProcess, pageNumber);
 
                 // Re-fetch the instruction
@@ -225,35 +698,47 @@ void runSchedulerSJF() {
 
 // Run SJF with Aging Scheduler
 void runSchedulerSJFwithAging() {
-    while (readyQueueHead != NULL) {
-        struct PCB *currentProcess = dequeue();
+    struct PCB *currentProcess = NULL;  // Kept across iterations while it has the lowest score
+    while (currentProcess != NULL || !readyQueueEmpty()) {
+        if (currentProcess == NULL) {
+            currentProcess = dequeueSJFAging();
+            if (currentProcess == NULL) {
+                continue;  // Another MT worker took the last one
+            }
+        }
 
         // Execute one instruction (time slice of 1)
         if (currentProcess->pc < currentProcess->length) {
+            if (multithreadEnabled) {
+                pinNextLine(currentProcess);
+            }
             char *line = getLineFromPCB(currentProcess);
 
             if (line == NULL) {
                 // Page not loaded or has been evicted, handle page fault
-                int pageNumber = currentProcess->pc / FRAME_SIZE;
+                int pageNumber = currentProcess->pc / frameSize;
                 handlePageFault(currentProcess, pageNumber);
 
                 // Re-fetch the instruction
                 line = getLineFromPCB(currentProcess);
                 if (line == NULL) {
+                    unpinFrame(currentProcess);
                     printf("Error: Unable to load instruction for process %d at PC %d.\n",
                            currentProcess->pid, currentProcess->pc);
                     // The process may need to be rescheduled
                     enqueueSJFAging(currentProcess);
+                    currentProcess = NULL;
                     continue;
                 }
             }
 
             parseInput(line);
+            unpinFrame(currentProcess);
             currentProcess->pc++;
         }
 
         // Aging: decrease jobLengthScore of other processes in the ready queue
-        ageReadyQueue(currentProcess);
+        ageReadyQueue();
 
         // Find the process with the lowest jobLengthScore
         struct PCB *lowestJob = findLowestScoreJob(currentProcess);
@@ -262,44 +747,51 @@ void runSchedulerSJFwithAging() {
             if (lowestJob != currentProcess) {
                 // Not the lowest score, re-enqueue the process
                 enqueueSJFAging(currentProcess);
-            } else {
-                // Lowest score, put it back at the head of the queue
-                lockReadyQueue();
-                currentProcess->next = readyQueueHead;
-                readyQueueHead = currentProcess;
-                unlockReadyQueue();
+                currentProcess = NULL;
             }
+            // Otherwise it still has the lowest score and runs the next instruction
         } else {
             // Process completed, clean up resources
             destroyPCB(currentProcess);
+            currentProcess = NULL;
         }
     }
 }
 
-// Aging: decrease jobLengthScore of other processes in the ready queue
-void ageReadyQueue(struct PCB *currentProcess) {
+// Aging: decrease jobLengthScore of other processes in the ready queue. The
+// running process is out of the heap, so advancing the epoch ages only the others.
+// Heap keys never change, so MT workers advance it without the ready queue lock.
+void ageReadyQueue() {
+    __atomic_add_fetch(&agingEpoch, 1, __ATOMIC_SEQ_CST);
+}
+
+// Score of a process waiting in the AGING heap: its score when enqueued less
+// one per instruction run since, stopping at 0
+static int agedScore(struct PCB *pcb) {
+    long score = pcb->heapKey - __atomic_load_n(&agingEpoch, __ATOMIC_SEQ_CST);
+    return score > 0 ? (int)score : 0;
+}
+
+// Take the process with the lowest aged score, settling its score before it
+// leaves the heap; NULL when the heap is empty
+static struct PCB *dequeueSJFAging() {
     lockReadyQueue();
-    struct PCB *current = readyQueueHead;
-    while (current != NULL) {
-        if (current != currentProcess && current->jobLengthScore > 0) {
-            current->jobLengthScore--;
-        }
-        current = current->next;
+    struct PCB *process = NULL;
+    if (readyHeapSize > 0) {
+        process = heapPop();
+        process->jobLengthScore = agedScore(process);
     }
     unlockReadyQueue();
+    return process;
 }
 
-// Find the process with the lowest jobLengthScore
+// Find the process with the lowest jobLengthScore: the top of the heap, unless
+// the current process's score is no higher
 struct PCB* findLowestScoreJob(struct PCB *currentProcess) {
     lockReadyQueue();
-    struct PCB *current = readyQueueHead;
     struct PCB *lowestJob = currentProcess;
-
-    while (current != NULL) {
-        if (current->jobLengthScore < lowestJob->jobLengthScore) {
-            lowestJob = current;
-        }
-        current = current->next;
+    if (readyHeapSize > 0 && agedScore(readyHeap[0]) < currentProcess->jobLengthScore) {
+        lowestJob = readyHeap[0];
     }
     unlockReadyQueue();
     return lowestJob;
@@ -308,76 +800,63 @@ struct PCB* findLowestScoreJob(struct PCB *currentProcess) {
 // Enqueue PCB to the ready queue based on SJF with Aging strategy
 void enqueueSJFAging(struct PCB *pcb) {
     lockReadyQueue();
-    if (readyQueueHead == NULL) {
-        readyQueueHead = pcb;
-        readyQueueTail = pcb;
-    } else {
-        struct PCB *prev = NULL;
-        struct PCB *current = readyQueueHead;
-
-        // Sort based on jobLengthScore
-        while (current != NULL && current->jobLengthScore <= pcb->jobLengthScore) {
-            prev = current;
-            current = current->next;
-        }
-
-        if (prev == NULL) {
-            // Insert at the head
-            pcb->next = readyQueueHead;
-            readyQueueHead = pcb;
-        } else {
-            // Insert in the middle or at the tail
-            pcb->next = current;
-            prev->next = pcb;
-            if (current == NULL) {
-                readyQueueTail = pcb;  // Update the tail
-            }
-        }
-    }
+    heapPush(pcb, pcb->jobLengthScore + __atomic_load_n(&agingEpoch, __ATOMIC_SEQ_CST));  // Lowest aged score first
     unlockReadyQueue();
 }
 
 // Run RR30 Scheduler (time slice of 30)
 void runSchedulerRR30() {
-    while (readyQueueHead != NULL) {
+    while (!readyQueueEmpty() || suspendedQueueHead != NULL || blockedQueueHead != NULL) {
+        // Wait for a page-in only when nothing else can run
+        wakeBlocked(readyQueueEmpty() && suspendedQueueHead == NULL);
+        controlLoad();
         struct PCB *currentProcess = dequeue();
+        if (currentProcess == NULL) {
+            continue;
+        }
+        int blocked = 0;
 
         // Execute instructions within the time slice
         for (int i = 0; i < 30; i++) {
-            if (currentProcess->pc >= currentProcess->length) {
+            if (!waitForLine(currentProcess)) {
                 break;  // Process has ended
             }
 
-            int pageNumber = currentProcess->pc / FRAME_SIZE;
-            int offset = currentProcess->pc % FRAME_SIZE;
+            int pageNumber = currentProcess->pc / frameSize;
+            int offset = currentProcess->pc % frameSize;
 
-            // Check if the page is in memory
-            if (currentProcess->pageTable[pageNumber] == -1) {
-                // Handle page fault
-                handlePageFault(currentProcess, pageNumber);
-
-                // Re-fetch frameNumber
-                int frameNumber = currentProcess->pageTable[pageNumber];
-                if (frameNumber == -1) {
-                    // Unable to load the page, skip this process
-                    printf("Error: Unable to load page %d for process %d.\n", pageNumber, currentProcess->pid);
+            // Check if the page is in memory, pinning it so other MT workers
+            // do not evict it while the line runs
+            int frameNumber = pinPage(currentProcess, pageNumber);
+            if (frameNumber == -1) {
+                // Handle page fault; an asynchronous one blocks the process
+                if (faultPage(currentProcess, pageNumber)) {
+                    blocked = 1;
                     break;
                 }
+
+                // Re-fetch frameNumber; another worker may evict the page again
+                // before it is pinned
+                while ((frameNumber = pinPage(currentProcess, pageNumber)) == -1) {
+                    handlePageFault(currentProcess, pageNumber);
+                }
                 accessFrame(frameNumber);
             }
 
             // Access the frame (update usage time)
-            int frameNumber = currentProcess->pageTable[pageNumber];
             accessFrame(frameNumber);
 
             // Fetch the instruction from PCB
             char *line = getLineFromPCB(currentProcess);
             if (line == NULL) {
                 // Unable to fetch instruction, possibly due to page eviction, handle page fault
+                unpinFrame(currentProcess);
                 handlePageFault(currentProcess, pageNumber);
+                pinPage(currentProcess, pageNumber);
                 // Re-fetch the instruction
                 line = getLineFromPCB(currentProcess);
                 if (line == NULL) {
+                    unpinFrame(currentProcess);
                     printf("Error: Unable to load instruction for process %d at PC %d.\n",
                            currentProcess->pid, currentProcess->pc);
                     break;
@@ -385,13 +864,15 @@ void runSchedulerRR30() {
             }
 
             parseInput(line);
+            unpinFrame(currentProcess);
             currentProcess->pc++;  // Move to the next instruction
         }
 
-        // Check if the process has completed
-        if (currentProcess->pc >= currentProcess->length) {
+        // Check if the process has completed; a streamed script is only
+        // complete once its loader has finished
+        if (currentProcess->pc >= currentProcess->length && currentProcess->lengthFinal) {
             destroyPCB(currentProcess);
-        } else {
+        } else if (!blocked) {
             // Process not completed, re-enqueue it
             enqueue(currentProcess);
         }
@@ -400,7 +881,10 @@ void runSchedulerRR30() {
 
 // Enqueue PCB to the head of the ready queue
 void enqueueToHead(struct PCB *pcb) {
+    int workingSet = multithreadEnabled ? 0 : claimWorkingSet(pcb);
     lockReadyQueue();
+    __atomic_add_fetch(&readyCount, 1, __ATOMIC_SEQ_CST);
+    readyWorkingSet += workingSet;
     if (readyQueueHead == NULL) {
         readyQueueHead = pcb;
         readyQueueTail = pcb;
@@ -13,6 +13,9 @@ void enqueueSJF(struct PCB *pcb);
 // Dequeue a process (PCB) from the ready queue
 struct PCB *dequeue();
 
+// Whether the ready queue is empty
+int readyQueueEmpty();
+
 
 // Run the FCFS scheduler to execute processes
 void runScheduler();
@@ -25,7 +28,19 @@ void runSchedulerRRInBackground();
 void runSchedulerSJFwithAgingInBackground();
 void enqueueToHead(struct PCB *pcb);
 void runSchedulerRR30();
+
+// Start the MT workers running a scheduler loop, each on its own run deque
+void startWorkers(void (*scheduler)());
+void joinWorkers();
+int isWorkerThread();
+int getWorkerId();
+
+// Choose how MT workers share ready processes: shared, deques or lockfree
+int setReadyQueueBackend(const char *name);
+void printReadyQueueBackend();
 void runSchedulerRR30InBackground();
+void setLoadControl(int enabled);
+void printLoadControlStats();
 
 
 
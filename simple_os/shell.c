@@ -10,6 +10,7 @@
 #include "shell.h"
 #include "interpreter.h"
 #include "shellmemory.h"
+#include "scheduler.h"
 #include <pthread.h>
 #include <sys/select.h>
 
@@ -22,7 +23,34 @@ void removeBackingStore();
 
 // Main function
 int main(int argc, char *argv[]) {
-    printf("Frame Store Size = %d; Variable Store Size = %d\n", FRAME_STORE_SIZE, VARIABLE_STORE_SIZE);
+    int opt;
+    char *pagePolicy = NULL;
+    int frameStoreLines = FRAME_STORE_SIZE;
+    int frameLines = DEFAULT_FRAME_SIZE;
+    int variables = VARIABLE_STORE_SIZE;
+
+    // Parse startup options
+    while ((opt = getopt(argc, argv, "p:f:s:v:")) != -1) {
+        if (opt == 'p') {
+            pagePolicy = optarg;
+        } else if (opt == 'f') {
+            frameStoreLines = atoi(optarg);
+        } else if (opt == 's') {
+            frameLines = atoi(optarg);
+        } else if (opt == 'v') {
+            variables = atoi(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-p LRU|CLOCK|SECOND_CHANCE|2Q|ARC] [-f FRAMESTORE] [-s FRAMESIZE] [-v VARSTORE]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (setMemorySizes(frameStoreLines, frameLines, variables) == -1) {
+        fprintf(stderr, "Invalid memory sizes: frame store %d, frame size %d, variable store %d\n",
+                frameStoreLines, frameLines, variables);
+        exit(1);
+    }
+
+    printf("Frame Store Size = %d; Variable Store Size = %d\n", frameStoreSize, variableStoreSize);
 
     char prompt = '$';  				// Shell prompt
     char userInput[MAX_USER_INPUT];		// Store user input
@@ -36,6 +64,10 @@ int main(int argc, char *argv[]) {
 
     // Initialize Shell memory
     mem_init();
+    if (pagePolicy != NULL && setReplacementPolicy(pagePolicy) == -1) {
+        fprintf(stderr, "Unknown page replacement policy: %s\n", pagePolicy);
+        exit(1);
+    }
 
    // initializeFrameStore();
 
@@ -57,10 +89,8 @@ int main(int argc, char *argv[]) {
         if (errorCode == -1) exit(99); // Ignore other errors
 
         if (feof(stdin)) {
-            // If end of file is reached, exit Shell
-            for (int i = 0; i < NUM_THREADS; i++) {
-                pthread_join(workerThreads[i], NULL);
-            }
+            // If end of file is reached, exit Shell once MT workers finish
+            joinWorkers();
             pthread_mutex_destroy(&readyQueueMutex);
             removeBackingStore();  // Delete backing store
             exit(0);
@@ -103,7 +133,9 @@ int wordEnding(char c) {
 
 // Parse user input
 int parseInput(char inp[]) {
-    char tmp[200], *words[100];
+    // A word takes at least one character and a separator, so long exec
+    // argument lists fit as long as the input line does
+    char tmp[MAX_USER_INPUT], *words[MAX_USER_INPUT / 2 + 1];
     int ix = 0, w = 0;
     int wordlen;
     int errorCode = 0;
@@ -130,14 +162,19 @@ int parseInput(char inp[]) {
         }
     }
 
+    // The input may be a script line in the frame store, which the command can
+    // evict or resize; copy any chained commands before running this one
+    char *chained = inp[ix] == ';' ? strdup(&inp[ix+1]) : NULL;
+
     errorCode = interpreter(words, w);
     for (size_t i = 0; i < w; ++i) {
         free(words[i]);
     }
 
-    if (inp[ix] == ';') {
+    if (chained != NULL) {
         // Handle chained commands
-        return parseInput(&inp[ix+1]);
+        errorCode = parseInput(chained);
+        free(chained);
     }
     return errorCode;
 }
@@ -145,27 +182,43 @@ int parseInput(char inp[]) {
 // Load Shell input as program (supports background execution)
 int loadShellInputAsProgram() {
     char shellInput[MAX_USER_INPUT];
-    int start = memoryIndex;  // Start index of the program in script memory
+    char *arena = NULL;     // All input lines, stored back to back
+    size_t arenaSize = 0;
+    size_t used = 0;
+    int lineCount = 0;
 
     // Read all input lines and store them as a program
     while (fgets(shellInput, MAX_USER_INPUT - 1, stdin) != NULL) {
         // Check if script memory has reached its maximum capacity
-        if (memoryIndex >= MAX_SCRIPTS) {
+        if (lineCount >= MAX_SCRIPTS) {
             printf("Error: Script memory is full, cannot store more lines.\n");
             break;
         }
 
-        // Store each line in scriptMemory
-        scriptMemory[memoryIndex] = (char *)malloc(strlen(shellInput) + 1);
-        if (scriptMemory[memoryIndex] == NULL) {
-            printf("Error: Failed to allocate memory for input line.\n");
-            break;
+        // Grow the arena to fit the line
+        size_t length = strlen(shellInput) + 1;
+        if (used + length > arenaSize) {
+            size_t newSize = arenaSize > 0 ? arenaSize * 2 : MAX_USER_INPUT;
+            while (used + length > newSize) {
+                newSize *= 2;
+            }
+            char *grown = (char *)realloc(arena, newSize);
+            if (grown == NULL) {
+                printf("Error: Failed to allocate memory for input line.\n");
+                break;
+            }
+            arena = grown;
+            arenaSize = newSize;
         }
-        strcpy(scriptMemory[memoryIndex], shellInput);
-
-        // Increment memoryIndex
-        memoryIndex++;
+        memcpy(arena + used, shellInput, length);
+        used += length;
+        lineCount++;
     }
 
-    return start;  // Return the start index of the program in script memory
+    // Return the start index of the program in script memory
+    int start = addScriptLines(arena, lineCount);
+    if (start == -1) {
+        printf("Error: Script memory is full, cannot store more lines.\n");
+    }
+    return start;
 }
@@ -1,222 +1,2574 @@
 // shellmemory.c
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include "shellmemory.h"
+#include "compress.h"
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <limits.h>
 
 #include "pcb.h"
+#include "scheduler.h"
+#include "interpreter.h"
 
-// Define frame size and storage size
-#define MAX_LINE_LENGTH 100  // Maximum length per line
-#define MAX_SCRIPTS 1000     // Maximum number of script lines
+// Memory sizes. FRAME_STORE_SIZE and VARIABLE_STORE_SIZE from the Makefile are
+// only the defaults; all three can be set at startup and changed with resize.
+int frameSize = DEFAULT_FRAME_SIZE;             // Lines per page and per frame
+int frameStoreSize = FRAME_STORE_SIZE;          // Lines in the frame store
+int frameCount = FRAME_STORE_SIZE / DEFAULT_FRAME_SIZE;  // Number of frames
+int variableStoreSize = VARIABLE_STORE_SIZE;    // Variables held before the store grows
 
-#define FRAME_SIZE 3
-//#define FRAME_STORE_SIZE 300  // Adjust based on actual requirements
-//#define VARIABLE_STORE_SIZE 10  // Adjust based on actual requirements
-
-// Calculate total number of frames
-#define FRAME_COUNT (FRAME_STORE_SIZE / FRAME_SIZE)
-
-// Variable storage structure
+// Variable storage structure. The store is an open addressing hash table with
+// linear probing; keys are interned when a variable is first set and values are
+// overwritten in place while they fit.
 struct memory_struct {
-    char *var;
+    char *var;               // Interned name, NULL for an empty slot
     char *value;
+    size_t valueCapacity;    // Bytes allocated for value
+    unsigned int hash;
+};
+
+// The table is split into independently locked segments chosen by the top bits
+// of the hash, so MT workers touching different variables do not contend and
+// a segment grows without stopping readers of the others.
+#define VARIABLE_STRIPE_BITS 4
+#define VARIABLE_STRIPES (1 << VARIABLE_STRIPE_BITS)
+
+struct VariableSegment {
+    pthread_rwlock_t lock;
+    struct memory_struct *slots;
+    int capacity;            // Number of slots, a power of two
+    int count;               // Number of variables set
+};
+
+// A frame holds frameSize line slots of MAX_LINE_LENGTH bytes; an empty string
+// marks an unused slot. Frames are cache line aligned so a page-in touches whole
+// lines of one frame only.
+#define CACHE_LINE_SIZE 64
+
+// Global variables and data structures. Every per-frame table below has
+// frameCount entries and is reallocated when the frame store is resized.
+struct VariableSegment variableStore[VARIABLE_STRIPES];   // Variable storage area
+char *frameStore = NULL;                                  // Frame storage area, one contiguous slab
+size_t frameStride = 0;                                   // Bytes per frame in the slab
+int *frameInUse = NULL;                                   // 1 if the frame holds a page, 0 if it is free
+long *frameKey = NULL;                                    // Content hash of the page in each frame
+int lastAccessedFrame = -1;                               // Repeated accesses to this frame are not re-reported
+
+// Stack of free frame numbers, popped lowest frame first
+int *freeFrames = NULL;
+int freeFrameCount = 0;
+
+// Inverted page table: the first PCB and page number mapped to each frame. Further
+// PCBs mapping the same frame are chained both ways through their pageSharers
+// entries, so a PCB leaves a frame shared by thousands of others in O(1).
+struct PCB **frameOwner = NULL;
+int *frameOwnerPage = NULL;
+int *frameRefCount = NULL;                                // Number of page table entries mapping the frame
+
+// Resident pages indexed by content hash, so identical pages of different
+// programs (or of one script run several times) share a frame
+int *contentBuckets = NULL;                               // 2 * frameCount buckets
+int *frameHashNext = NULL;
+int sharedMappingCount = 0;
+
+// Paging statistics
+int pageFaultCount = 0;
+int pageEvictionCount = 0;
+
+// Sequential read-ahead. A fault that continues a PCB's sequential progress also
+// loads the next prefetchWindow pages; the window grows by one each time a
+// prefetched page is used and halves each time one is evicted unused.
+#define PREFETCH_DEFAULT_LIMIT 8
+
+int prefetchLimit = PREFETCH_DEFAULT_LIMIT;  // Largest window, 0 disables read-ahead
+int *framePrefetched = NULL;                 // 1 while a prefetched page has not been used
+int *frameLoading = NULL;                    // 1 while the frame is being evicted or filled
+int prefetchedPageCount = 0;
+int prefetchHitCount = 0;
+int prefetchWasteCount = 0;
+
+// Concurrent paging for MT workers. Paging state is guarded by pagingMutex,
+// which is dropped while a page is copied in from the backing store; the frame
+// stays marked loading and indexed by its content, so a worker faulting on the
+// same content waits for that copy instead of reading the page twice. A worker
+// pins the frame holding the line it runs, and a pinned frame is never chosen
+// as a victim. References are stamped from an atomic clock without taking the
+// lock. The first reference to a frame since the last victim choice also logs
+// the frame in the thread's access log, and the next victim choice hands only
+// the logged frames to the replacement policy, in clock order.
+static pthread_mutex_t pagingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pagingChanged = PTHREAD_COND_INITIALIZER;  // A frame was filled or unpinned
+static int pagingWaiters = 0;        // Workers waiting on pagingChanged
+static long accessClock = 0;         // Usage clock, advanced atomically
+int *framePins = NULL;               // Workers running a line from the frame
+static int pinnedFrameCount = 0;     // Frames with at least one pin, advanced atomically
+static int loadingFrameCount = 0;    // Frames marked loading
+long *frameAccessStamp = NULL;       // Clock value of the frame's last reference
+long *frameAppliedStamp = NULL;      // Last stamp the replacement policy has seen
+
+struct FrameAccess {
+    long stamp;
+    int frameNumber;
+};
+
+struct FrameAccess *accessBatch = NULL;  // Stamped references waiting for the policy
+
+// Frames referenced since the last victim choice, one log for the main thread
+// and one per MT worker. A frame sits in at most one log until the next victim
+// choice drains them, so no log holds more than frameCount entries.
+struct AccessLog {
+    pthread_mutex_t lock;
+    int *frames;
+    int count;
+};
+
+static struct AccessLog accessLogs[MAX_WORKERS + 1];
+int *frameLogged = NULL;             // Frame is waiting in an access log
+int coalescedFaultCount = 0;         // Faults served by another worker's page-in
+int pinWaitCount = 0;                // Evictions that waited for a worker to unpin
+
+// Compressed swap cache: an evicted page is compressed and kept here, keyed by
+// the script line it starts at, so faulting it back in skips reading the
+// script. Entries are taken out on a hit, dropped oldest first when the cache
+// is over capacity, and dropped when their script lines are released.
+#define SWAP_CACHE_DEFAULT_CAPACITY 16384  // Bytes of compressed pages
+#define SWAP_CACHE_BUCKETS 256
+
+struct SwapEntry {
+    int lineIndex;               // Script line the page starts at
+    long key;                    // Content hash of the page
+    int packedSize;              // Bytes of the packed page
+    int size;                    // Bytes of compressed data
+    struct SwapEntry *hashNext;
+    struct SwapEntry *prev;      // Age order, oldest at swapCacheHead
+    struct SwapEntry *next;
+    unsigned char data[];
+};
+
+struct SwapEntry *swapBuckets[SWAP_CACHE_BUCKETS];
+struct SwapEntry *swapCacheHead = NULL;
+struct SwapEntry *swapCacheTail = NULL;
+int swapCacheCapacity = SWAP_CACHE_DEFAULT_CAPACITY;  // 0 disables the cache
+int swapCacheUsed = 0;          // Bytes of compressed data held
+int swapCacheEntries = 0;
+int swapStoreCount = 0;         // Pages compressed into the cache
+int swapRejectCount = 0;        // Evicted pages that did not compress or fit
+int swapHitCount = 0;           // Page-ins served from the cache
+int swapMissCount = 0;          // Page-ins read from the script
+long swapPackedBytes = 0;       // Bytes stored, before and after compression
+long swapCompressedBytes = 0;
+
+// A page is packed as its lines back to back, each ending in '\0'. Stores and
+// loads use separate buffers because a load can evict, and so store, a page.
+unsigned char *swapStoreBuffer = NULL;
+unsigned char *swapCompressBuffer = NULL;
+unsigned char *swapLoadBuffer = NULL;
+int swapBufferSize = 0;
+
+// Asynchronous page-in. With asyncPageIn set, the scheduler reserves a frame for
+// a faulting page (evicting if needed) and queues the read from the backing
+// store to a loader thread; the page is indexed and mapped once the scheduler
+// collects the finished request. Only the loader touches a frame while it is
+// being filled, and such a frame is never chosen as a victim.
+struct PageInRequest {
+    struct PCB *pcb;
+    int pageNumber;
+    int frameNumber;
+    long key;                    // Content hash, computed by the loader
+    struct PageInRequest *next;
+};
+
+int asyncPageIn = 0;
+pthread_mutex_t pageInMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pageInQueued = PTHREAD_COND_INITIALIZER;
+pthread_cond_t pageInFinished = PTHREAD_COND_INITIALIZER;
+struct PageInRequest *pageInQueueHead = NULL;   // Waiting for the loader
+struct PageInRequest *pageInQueueTail = NULL;
+struct PageInRequest *pageInDoneHead = NULL;    // Loaded, waiting for the scheduler
+struct PageInRequest *pageInDoneTail = NULL;
+int pageInsOutstanding = 0;      // Queued and not yet collected (scheduler thread only)
+int loaderStarted = 0;
+pthread_t loaderThread;
+int asyncPageInCount = 0;        // Page-ins handed to the loader
+int pageInWaitCount = 0;         // Times the scheduler had nothing to run but a page-in
+
+// Script memory (for backing store). Each entry points at the start of a line
+// and records its length, including the newline; lines are not NUL-terminated.
+// Script memory starts with SCRIPT_MEMORY_SIZE lines and grows a chunk of
+// SCRIPT_CHUNK_LINES entries at a time. Chunks never move, so a worker can read
+// a line while another thread grows script memory.
+//
+// Each program's lines live in one block recorded at the program's start index:
+// the read-only mapping of its backing store file, or a heap arena for input
+// that has no file. Loads of the same script in one exec share the block and
+// its line range, which is released when the last of them finishes. Ranges
+// released by finished programs are kept sorted by start, coalesced, and
+// reused first-fit before memoryIndex is advanced.
+struct ScriptLine {
+    char *text;          // Start of the line
+    int length;          // Bytes of the line, at most MAX_LINE_LENGTH - 1
+    int users;           // At a program's start index: loads running its lines
+    int demand;          // At a page's first line: ready processes about to fault the page in
+    char *arena;         // At a program's start index: its arena or mapping
+    size_t mappingSize;  // Bytes mapped there, 0 for a heap arena
+};
+
+struct ScriptSegment {
+    int start;
+    int length;
 };
 
-// Global variables and data structures
-struct memory_struct variableStore[VARIABLE_STORE_SIZE];  // Variable storage area
-char *frameStore[FRAME_COUNT * FRAME_SIZE];               // Frame storage area
-int frameUsage[FRAME_COUNT];                              // Tracks the last usage time of each frame
-int currentTime = 0;                                      // Global time counter for LRU algorithm
+static struct ScriptLine *scriptChunks[MAX_SCRIPTS / SCRIPT_CHUNK_LINES];
+static int scriptChunkCount = 0;
+int memoryIndex = 0;               // End of the highest line range in use in script memory
+struct ScriptSegment *freeSegments = NULL;  // Free line ranges below memoryIndex
+int freeSegmentCount = 0;
+int freeSegmentCapacity = 0;
+
+// The streaming loader reserves and releases ranges from its own thread
+static pthread_mutex_t scriptMemoryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Entry of script memory for a line index
+static struct ScriptLine *scriptLine(int index) {
+    return &scriptChunks[index / SCRIPT_CHUNK_LINES][index % SCRIPT_CHUNK_LINES];
+}
+
+// Add chunks until script memory holds at least lines entries. Returns 0, or
+// -1 if it cannot grow that far. The caller holds scriptMemoryMutex.
+static int growScriptMemory(int lines) {
+    if (lines > MAX_SCRIPTS) {
+        return -1;
+    }
+    while (scriptChunkCount * SCRIPT_CHUNK_LINES < lines) {
+        struct ScriptLine *chunk = (struct ScriptLine *)calloc(SCRIPT_CHUNK_LINES, sizeof(struct ScriptLine));
+        if (chunk == NULL) {
+            return -1;
+        }
+        scriptChunks[scriptChunkCount++] = chunk;
+    }
+    return 0;
+}
+
+// Streaming loader. Scripts of STREAM_MIN_BYTES or more are copied to the
+// backing store and indexed by a loader thread, a chunk at a time, while
+// earlier pages already run; a process waits only for the lines it reaches.
+// Lines are counted before the load is queued and script memory for all of
+// them is reserved then, so a script that does not fit is refused before any
+// of it runs. The loader works through scripts in submission order, and once
+// it is busy every later script is queued behind it.
+#define STREAM_MIN_BYTES 4096
+#define STREAM_CHUNK_BYTES 16384
+
+struct ScriptLoad {
+    struct PCB *pcb;
+    int sourceFd;
+    char *base;          // Backing store mapping being filled
+    size_t size;
+    int start;           // Line range reserved for the script
+    int lineCount;
+    struct ScriptLoad *next;
+};
+
+static pthread_mutex_t scriptLoadMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scriptLoadQueued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t scriptLinesLoaded = PTHREAD_COND_INITIALIZER;  // Lines indexed or a load ended
+static struct ScriptLoad *scriptLoadHead = NULL;
+static struct ScriptLoad *scriptLoadTail = NULL;
+static int scriptLoadsPending = 0;   // Queued or in progress
+static int scriptLoaderStarted = 0;
+
+/*
+ * Page replacement policies.
+ *
+ * A policy is told when a page is placed in a frame and when a resident frame is
+ * accessed, and picks the victim when no free frame is left. selectVictim removes
+ * the victim from the policy's own bookkeeping; the caller then evicts it.
+ */
+struct ReplacementPolicy {
+    const char *name;
+    void (*reset)(void);                          // Forget every frame
+    void (*pageLoaded)(int frameNumber, long key); // A page was placed in a frame
+    void (*frameAccessed)(int frameNumber);        // A resident frame was referenced
+    int (*selectVictim)(long incomingKey);         // Choose a frame to evict, -1 if none
+};
+
+// Intrusive doubly linked lists over frame numbers. A frame is on at most one list
+// at a time; head is the oldest entry, tail the newest. -1 terminates a list.
+struct FrameList {
+    int head;
+    int tail;
+    int size;
+};
+
+int *framePrev = NULL;
+int *frameNext = NULL;
+int *frameList = NULL;  // Index of the list holding the frame, -1 if none
+struct FrameList frameLists[2];
+
+// Reference bits for CLOCK and second-chance
+int *frameReferenced = NULL;
+int clockHand = 0;
+
+// Ghost lists remember the keys of recently evicted pages (2Q's A1out, ARC's B1/B2).
+// Entries come from a pool of frameCount + 1 and are found through a chained hash
+// on the key with twice as many buckets.
+#define GHOST_CAPACITY (frameCount + 1)
+#define GHOST_BUCKETS (2 * GHOST_CAPACITY)
+
+struct GhostEntry {
+    long key;
+    int list;      // Index of the ghost list holding the entry, -1 if free
+    int prev;
+    int next;
+    int hashNext;
+};
+
+struct GhostEntry *ghosts = NULL;
+int *ghostBuckets = NULL;
+int ghostFreeHead = -1;
+struct FrameList ghostLists[2];
+
+// 2Q: A1in is frameLists[0], Am is frameLists[1], A1out is ghostLists[0]
+#define TWOQ_KIN (frameCount / 4 > 0 ? frameCount / 4 : 1)
+#define TWOQ_KOUT (frameCount / 2 > 0 ? frameCount / 2 : 1)
+
+// ARC: T1/T2 are frameLists[0]/[1], B1/B2 are ghostLists[0]/[1]; arcTarget is p
+int arcTarget = 0;
+
+struct ReplacementPolicy *replacementPolicy = NULL;  // Active policy, LRU unless selected otherwise
+
+// Frame quotas. Unless the mode is none, every loaded process gets a quota of
+// resident pages: an equal share of the frames, a share proportional to its
+// page count, or (PFF) an equal share that then follows its page fault rate.
+// A process at its quota replaces one of its own pages on a fault (local
+// replacement); one under its quota that finds no free frame takes one from
+// processes over theirs first. Mapping a frame another process already holds
+// costs no frame and is not limited.
+#define QUOTA_NONE 0
+#define QUOTA_EQUAL 1
+#define QUOTA_PROPORTIONAL 2
+#define QUOTA_PFF 3
+
+static const char *quotaModeNames[] = {"none", "equal", "proportional", "pff"};
+int frameQuotaMode = QUOTA_NONE;
+int localReplacementCount = 0;
+static int totalFrameQuota = 0;  // Sum of the quotas of processes that have one
+
+// PFF: a process faulting again within one page's worth of instructions gets
+// another frame; one running PFF_SHRINK_PAGES pages' worth without a fault
+// gives one back
+#define PFF_SHRINK_PAGES 4
+
+// Frames the policy may pick as a victim: any, only private pages of
+// victimPCB (local replacement), or only unmapped frames and frames mapped by
+// processes that are all over their quota (spare)
+#define VICTIM_ANY 0
+#define VICTIM_LOCAL 1
+#define VICTIM_SPARE 2
 
-// Script memory (for backing store)
-char *scriptMemory[MAX_SCRIPTS];  // Stores script lines
-int memoryIndex = 0;              // Tracks the next storage position in scriptMemory
+static int victimMode = VICTIM_ANY;
+static struct PCB *victimPCB = NULL;
 
-// Global PCB linked list head for updating page tables
-extern struct PCB *pcbListHead;
+static int victimAllowed(int frameNumber) {
+    if (frameLoading[frameNumber] || __atomic_load_n(&framePins[frameNumber], __ATOMIC_SEQ_CST) > 0) {
+        return 0;  // Being filled, or a worker is running a line from it
+    }
+    if (victimMode == VICTIM_LOCAL) {
+        return frameRefCount[frameNumber] == 1 && frameOwner[frameNumber] == victimPCB;
+    }
+    if (victimMode == VICTIM_SPARE) {
+        struct PCB *pcb = frameOwner[frameNumber];
+        int pageNumber = frameOwnerPage[frameNumber];
+        while (pcb != NULL) {
+            if (pcb->pages_loaded <= pcb->frameQuota) {
+                return 0;
+            }
+            struct PageSharer next = pcb->pageSharers[pageNumber];
+            pcb = next.pcb;
+            pageNumber = next.page;
+        }
+    }
+    return 1;
+}
+
+// Mark a frame as being filled, or as filled, keeping count of such frames.
+// Called with the paging lock held.
+static void setFrameLoading(int frameNumber, int loading) {
+    if (frameLoading[frameNumber] != loading) {
+        loadingFrameCount += loading ? 1 : -1;
+        __atomic_store_n(&frameLoading[frameNumber], loading, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void allocateFrameTables();
+int finishPageIns(int wait);
+static void adjustFaultQuota(struct PCB *pcb);
+static void waitForScriptLines(struct PCB *pcb, int lines);
+static void swapCacheInvalidate(int start, int lineCount);
+static void freeScriptRange(int start, int lineCount);
+void waitForScriptLoader();
 
 // Initialize memory
 void mem_init() {
     int i;
-    // Initialize variable storage area
-    for (i = 0; i < VARIABLE_STORE_SIZE; i++) {
-        variableStore[i].var = NULL;
-        variableStore[i].value = NULL;
+    // Initialize variable storage area, sized to hold variableStoreSize
+    // variables before it first grows
+    for (i = 0; i < VARIABLE_STRIPES; i++) {
+        pthread_rwlock_init(&variableStore[i].lock, NULL);
+        variableStore[i].capacity = 0;
+        variableStore[i].slots = NULL;
+        variableStore[i].count = 0;
+    }
+    resizeVariableStore(variableStoreSize);
+
+    for (i = 0; i <= MAX_WORKERS; i++) {
+        pthread_mutex_init(&accessLogs[i].lock, NULL);
+    }
+
+    // Initialize frame storage area
+    frameCount = frameStoreSize / frameSize;
+    allocateFrameTables();
+    sharedMappingCount = 0;
+    pageFaultCount = 0;
+    pageEvictionCount = 0;
+    prefetchedPageCount = 0;
+    prefetchHitCount = 0;
+    prefetchWasteCount = 0;
+
+    // Initialize script memory
+    growScriptMemory(SCRIPT_MEMORY_SIZE);
+    memoryIndex = 0;
+    freeSegmentCount = 0;
+
+    // Other initialization...
+}
+
+// Line slot of a frame in the slab
+static char *frameLine(int frameNumber, int line) {
+    return frameStore + (size_t)frameNumber * frameStride + (size_t)line * MAX_LINE_LENGTH;
+}
+
+// Allocate every per-frame table for frameCount empty frames
+static void allocateFrameTables() {
+    int i;
+
+    frameStride = ((size_t)frameSize * MAX_LINE_LENGTH + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    if (posix_memalign((void **)&frameStore, CACHE_LINE_SIZE, frameStride * frameCount) != 0) {
+        printf("Error: Cannot allocate the frame store\n");
+        exit(1);
+    }
+    memset(frameStore, 0, frameStride * frameCount);
+
+    frameInUse = (int *)calloc(frameCount, sizeof(int));
+    frameKey = (long *)malloc(sizeof(long) * frameCount);
+    freeFrames = (int *)malloc(sizeof(int) * frameCount);
+    frameOwner = (struct PCB **)calloc(frameCount, sizeof(struct PCB *));
+    frameOwnerPage = (int *)malloc(sizeof(int) * frameCount);
+    frameRefCount = (int *)calloc(frameCount, sizeof(int));
+    contentBuckets = (int *)malloc(sizeof(int) * 2 * frameCount);
+    frameHashNext = (int *)malloc(sizeof(int) * frameCount);
+    framePrefetched = (int *)calloc(frameCount, sizeof(int));
+    framePrev = (int *)malloc(sizeof(int) * frameCount);
+    frameNext = (int *)malloc(sizeof(int) * frameCount);
+    frameList = (int *)malloc(sizeof(int) * frameCount);
+    frameReferenced = (int *)calloc(frameCount, sizeof(int));
+    frameLoading = (int *)calloc(frameCount, sizeof(int));
+    framePins = (int *)calloc(frameCount, sizeof(int));
+    loadingFrameCount = 0;
+    pinnedFrameCount = 0;
+    frameAccessStamp = (long *)calloc(frameCount, sizeof(long));
+    frameAppliedStamp = (long *)calloc(frameCount, sizeof(long));
+    accessBatch = (struct FrameAccess *)malloc(sizeof(struct FrameAccess) * frameCount);
+    frameLogged = (int *)calloc(frameCount, sizeof(int));
+    for (i = 0; i <= MAX_WORKERS; i++) {
+        accessLogs[i].frames = (int *)malloc(sizeof(int) * frameCount);
+        accessLogs[i].count = 0;
+    }
+    ghosts = (struct GhostEntry *)malloc(sizeof(struct GhostEntry) * GHOST_CAPACITY);
+    ghostBuckets = (int *)malloc(sizeof(int) * GHOST_BUCKETS);
+
+    swapBufferSize = frameSize * MAX_LINE_LENGTH;
+    swapStoreBuffer = (unsigned char *)malloc(swapBufferSize);
+    swapCompressBuffer = (unsigned char *)malloc(swapBufferSize);
+    swapLoadBuffer = (unsigned char *)malloc(swapBufferSize);
+
+    for (i = 0; i < frameCount; i++) {
+        frameKey[i] = -1;
+        frameOwnerPage[i] = -1;
+        frameHashNext[i] = -1;
+    }
+    for (i = 0; i < 2 * frameCount; i++) {
+        contentBuckets[i] = -1;
+    }
+    lastAccessedFrame = -1;
+    setReplacementPolicy(replacementPolicy != NULL ? replacementPolicy->name : "LRU");
+
+    // Push frames in reverse so the lowest numbered frame is handed out first
+    freeFrameCount = 0;
+    for (i = frameCount - 1; i >= 0; i--) {
+        freeFrames[freeFrameCount++] = i;
+    }
+}
+
+static void freeFrameTables() {
+    free(frameStore);
+    free(frameInUse);
+    free(frameKey);
+    free(freeFrames);
+    free(frameOwner);
+    free(frameOwnerPage);
+    free(frameRefCount);
+    free(contentBuckets);
+    free(frameHashNext);
+    free(framePrefetched);
+    free(framePrev);
+    free(frameNext);
+    free(frameList);
+    free(frameReferenced);
+    free(frameLoading);
+    free(framePins);
+    free(frameAccessStamp);
+    free(frameAppliedStamp);
+    free(accessBatch);
+    free(frameLogged);
+    for (int i = 0; i <= MAX_WORKERS; i++) {
+        free(accessLogs[i].frames);
+    }
+    free(ghosts);
+    free(ghostBuckets);
+    free(swapStoreBuffer);
+    free(swapCompressBuffer);
+    free(swapLoadBuffer);
+}
+
+static void listReset(struct FrameList *list) {
+    list->head = -1;
+    list->tail = -1;
+    list->size = 0;
+}
+
+// Unlink a frame from the list holding it
+static void frameListUnlink(int frameNumber) {
+    struct FrameList *list = &frameLists[frameList[frameNumber]];
+    int prev = framePrev[frameNumber];
+    int next = frameNext[frameNumber];
+
+    if (prev != -1) {
+        frameNext[prev] = next;
+    } else {
+        list->head = next;
+    }
+    if (next != -1) {
+        framePrev[next] = prev;
+    } else {
+        list->tail = prev;
+    }
+    list->size--;
+    framePrev[frameNumber] = -1;
+    frameNext[frameNumber] = -1;
+    frameList[frameNumber] = -1;
+}
+
+// Append a frame to the tail of a list
+static void frameListAppend(int listIndex, int frameNumber) {
+    struct FrameList *list = &frameLists[listIndex];
+
+    framePrev[frameNumber] = list->tail;
+    frameNext[frameNumber] = -1;
+    if (list->tail != -1) {
+        frameNext[list->tail] = frameNumber;
+    } else {
+        list->head = frameNumber;
+    }
+    list->tail = frameNumber;
+    list->size++;
+    frameList[frameNumber] = listIndex;
+}
+
+// First frame of a list, from the head, the policy may evict; -1 if none
+static int frameListFirstAllowed(int listIndex) {
+    int frameNumber = frameLists[listIndex].head;
+    while (frameNumber != -1 && !victimAllowed(frameNumber)) {
+        frameNumber = frameNext[frameNumber];
+    }
+    return frameNumber;
+}
+
+static void frameListsReset() {
+    for (int i = 0; i < frameCount; i++) {
+        framePrev[i] = -1;
+        frameNext[i] = -1;
+        frameList[i] = -1;
+        frameReferenced[i] = 0;
+    }
+    listReset(&frameLists[0]);
+    listReset(&frameLists[1]);
+    clockHand = 0;
+}
+
+static int ghostBucket(long key) {
+    return (int)(((unsigned long)key * 0x9E3779B97F4A7C15UL) % GHOST_BUCKETS);
+}
+
+static void ghostReset() {
+    for (int i = 0; i < GHOST_BUCKETS; i++) {
+        ghostBuckets[i] = -1;
+    }
+    ghostFreeHead = -1;
+    for (int i = GHOST_CAPACITY - 1; i >= 0; i--) {
+        ghosts[i].list = -1;
+        ghosts[i].next = ghostFreeHead;
+        ghostFreeHead = i;
+    }
+    listReset(&ghostLists[0]);
+    listReset(&ghostLists[1]);
+}
+
+// Find the ghost entry for a key, -1 if the key is not remembered
+static int ghostFind(long key) {
+    for (int g = ghostBuckets[ghostBucket(key)]; g != -1; g = ghosts[g].hashNext) {
+        if (ghosts[g].key == key) {
+            return g;
+        }
+    }
+    return -1;
+}
+
+// Forget a ghost entry and return it to the pool
+static void ghostRemove(int g) {
+    struct FrameList *list = &ghostLists[ghosts[g].list];
+
+    if (ghosts[g].prev != -1) {
+        ghosts[ghosts[g].prev].next = ghosts[g].next;
+    } else {
+        list->head = ghosts[g].next;
+    }
+    if (ghosts[g].next != -1) {
+        ghosts[ghosts[g].next].prev = ghosts[g].prev;
+    } else {
+        list->tail = ghosts[g].prev;
+    }
+    list->size--;
+
+    int *link = &ghostBuckets[ghostBucket(ghosts[g].key)];
+    while (*link != g) {
+        link = &ghosts[*link].hashNext;
+    }
+    *link = ghosts[g].hashNext;
+
+    ghosts[g].list = -1;
+    ghosts[g].next = ghostFreeHead;
+    ghostFreeHead = g;
+}
+
+// Forget the oldest key of a ghost list
+static void ghostPop(int listIndex) {
+    if (ghostLists[listIndex].head != -1) {
+        ghostRemove(ghostLists[listIndex].head);
+    }
+}
+
+// Remember the key of an evicted page at the tail of a ghost list
+static void ghostPush(int listIndex, long key) {
+    if (ghostFreeHead == -1) {
+        // Pool exhausted: drop the oldest ghost, preferring the same list
+        ghostPop(ghostLists[listIndex].size > 0 ? listIndex : 1 - listIndex);
+    }
+    int g = ghostFreeHead;
+    ghostFreeHead = ghosts[g].next;
+
+    struct FrameList *list = &ghostLists[listIndex];
+    ghosts[g].key = key;
+    ghosts[g].list = listIndex;
+    ghosts[g].prev = list->tail;
+    ghosts[g].next = -1;
+    if (list->tail != -1) {
+        ghosts[list->tail].next = g;
+    } else {
+        list->head = g;
+    }
+    list->tail = g;
+    list->size++;
+
+    int bucket = ghostBucket(key);
+    ghosts[g].hashNext = ghostBuckets[bucket];
+    ghostBuckets[bucket] = g;
+}
+
+// LRU: a single list ordered by last access
+
+static void lruReset() {
+    frameListsReset();
+}
+
+static void lruPageLoaded(int frameNumber, long key) {
+    frameListAppend(0, frameNumber);
+}
+
+static void lruFrameAccessed(int frameNumber) {
+    frameListUnlink(frameNumber);
+    frameListAppend(0, frameNumber);
+}
+
+static int lruSelectVictim(long incomingKey) {
+    int frameNumber = frameListFirstAllowed(0);
+    if (frameNumber != -1) {
+        frameListUnlink(frameNumber);
+    }
+    return frameNumber;
+}
+
+// CLOCK: a hand sweeps the frames in order, clearing reference bits until it
+// finds a frame that has not been referenced since the last sweep
+
+static void clockReset() {
+    frameListsReset();
+}
+
+static void clockPageLoaded(int frameNumber, long key) {
+    frameReferenced[frameNumber] = 1;
+}
+
+static void clockFrameAccessed(int frameNumber) {
+    frameReferenced[frameNumber] = 1;
+}
+
+static int clockSelectVictim(long incomingKey) {
+    // Two sweeps are enough: the first clears every reference bit
+    for (int step = 0; step < 2 * frameCount; step++) {
+        int frameNumber = clockHand;
+        clockHand = (clockHand + 1) % frameCount;
+        if (!frameInUse[frameNumber] || !victimAllowed(frameNumber)) {
+            continue;
+        }
+        if (frameReferenced[frameNumber]) {
+            frameReferenced[frameNumber] = 0;
+            continue;
+        }
+        return frameNumber;
+    }
+    return -1;
+}
+
+// Second chance: FIFO order of arrival, but a referenced frame at the head is
+// moved to the tail with its reference bit cleared instead of being evicted
+
+static void secondChanceReset() {
+    frameListsReset();
+}
+
+static void secondChancePageLoaded(int frameNumber, long key) {
+    frameReferenced[frameNumber] = 0;
+    frameListAppend(0, frameNumber);
+}
+
+static void secondChanceFrameAccessed(int frameNumber) {
+    frameReferenced[frameNumber] = 1;
+}
+
+static int secondChanceSelectVictim(long incomingKey) {
+    // Frames the policy may not evict keep their place and reference bit
+    int steps = 2 * frameLists[0].size + 1;
+    int frameNumber = frameLists[0].head;
+    while (frameNumber != -1 && steps-- > 0) {
+        int next = frameNext[frameNumber];
+        if (victimAllowed(frameNumber)) {
+            frameListUnlink(frameNumber);
+            if (!frameReferenced[frameNumber]) {
+                return frameNumber;
+            }
+            frameReferenced[frameNumber] = 0;
+            frameListAppend(0, frameNumber);
+        }
+        frameNumber = next != -1 ? next : frameLists[0].head;
+    }
+    return -1;
+}
+
+// 2Q: new pages enter the A1in FIFO; only pages faulted back in while their key
+// is still in A1out are promoted to the Am LRU list, so one-off scans never
+// displace the pages that are actually reused
+
+static void twoQReset() {
+    frameListsReset();
+    ghostReset();
+}
+
+static void twoQPageLoaded(int frameNumber, long key) {
+    int g = ghostFind(key);
+    if (g != -1) {
+        ghostRemove(g);
+        frameListAppend(1, frameNumber);
+    } else {
+        frameListAppend(0, frameNumber);
+    }
+}
+
+static void twoQFrameAccessed(int frameNumber) {
+    if (frameList[frameNumber] == 1) {
+        frameListUnlink(frameNumber);
+        frameListAppend(1, frameNumber);
+    }
+}
+
+static int twoQSelectVictim(long incomingKey) {
+    int fromA1in = frameLists[0].size > TWOQ_KIN || frameLists[1].size == 0;
+    int frameNumber = frameListFirstAllowed(fromA1in ? 0 : 1);
+    if (frameNumber == -1) {
+        fromA1in = !fromA1in;
+        frameNumber = frameListFirstAllowed(fromA1in ? 0 : 1);
+        if (frameNumber == -1) {
+            return -1;
+        }
+    }
+    frameListUnlink(frameNumber);
+    if (fromA1in) {
+        ghostPush(0, frameKey[frameNumber]);
+        if (ghostLists[0].size > TWOQ_KOUT) {
+            ghostPop(0);
+        }
+    }
+    return frameNumber;
+}
+
+// ARC: T1 holds pages seen once recently, T2 pages seen at least twice. Ghost hits
+// in B1/B2 move the target size of T1 towards whichever list would have kept the page
+
+static void arcReset() {
+    frameListsReset();
+    ghostReset();
+    arcTarget = 0;
+}
+
+static void arcPageLoaded(int frameNumber, long key) {
+    int g = ghostFind(key);
+    if (g != -1) {
+        ghostRemove(g);
+        frameListAppend(1, frameNumber);
+    } else {
+        frameListAppend(0, frameNumber);
+    }
+
+    // Keep |T1| + |B1| <= c and the whole directory <= 2c
+    while (frameLists[0].size + ghostLists[0].size > frameCount && ghostLists[0].size > 0) {
+        ghostPop(0);
+    }
+    while (frameLists[0].size + frameLists[1].size + ghostLists[0].size + ghostLists[1].size > 2 * frameCount
+           && ghostLists[1].size > 0) {
+        ghostPop(1);
+    }
+}
+
+static void arcFrameAccessed(int frameNumber) {
+    frameListUnlink(frameNumber);
+    frameListAppend(1, frameNumber);
+}
+
+static int arcSelectVictim(long incomingKey) {
+    int g = ghostFind(incomingKey);
+    int inB2 = g != -1 && ghosts[g].list == 1;
+    int previousTarget = arcTarget;
+
+    // Adapt the target size of T1
+    if (g != -1 && !inB2) {
+        int delta = ghostLists[1].size / ghostLists[0].size;
+        arcTarget += delta > 1 ? delta : 1;
+        if (arcTarget > frameCount) arcTarget = frameCount;
+    } else if (inB2) {
+        int delta = ghostLists[0].size / ghostLists[1].size;
+        arcTarget -= delta > 1 ? delta : 1;
+        if (arcTarget < 0) arcTarget = 0;
+    }
+
+    int t1 = frameLists[0].size;
+    int fromT1 = t1 > 0 && (t1 > arcTarget || (inB2 && t1 == arcTarget) || frameLists[1].size == 0);
+    int frameNumber = frameListFirstAllowed(fromT1 ? 0 : 1);
+    if (frameNumber == -1) {
+        fromT1 = !fromT1;
+        frameNumber = frameListFirstAllowed(fromT1 ? 0 : 1);
+        if (frameNumber == -1) {
+            arcTarget = previousTarget;  // The caller retries with fewer restrictions
+            return -1;
+        }
+    }
+    frameListUnlink(frameNumber);
+    ghostPush(fromT1 ? 0 : 1, frameKey[frameNumber]);
+    return frameNumber;
+}
+
+static struct ReplacementPolicy replacementPolicies[] = {
+    {"LRU", lruReset, lruPageLoaded, lruFrameAccessed, lruSelectVictim},
+    {"CLOCK", clockReset, clockPageLoaded, clockFrameAccessed, clockSelectVictim},
+    {"SECOND_CHANCE", secondChanceReset, secondChancePageLoaded, secondChanceFrameAccessed, secondChanceSelectVictim},
+    {"2Q", twoQReset, twoQPageLoaded, twoQFrameAccessed, twoQSelectVictim},
+    {"ARC", arcReset, arcPageLoaded, arcFrameAccessed, arcSelectVictim},
+};
+
+#define POLICY_COUNT (int)(sizeof(replacementPolicies) / sizeof(replacementPolicies[0]))
+
+// Select the page replacement policy by name; resident pages are handed to the
+// new policy in frame order. Returns 0 on success, -1 if the name is unknown.
+int setReplacementPolicy(const char *name) {
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        if (strcmp(replacementPolicies[i].name, name) == 0) {
+            lockPaging();
+            replacementPolicy = &replacementPolicies[i];
+            replacementPolicy->reset();
+            for (int f = 0; f < frameCount; f++) {
+                if (frameInUse[f] && !frameLoading[f]) {
+                    replacementPolicy->pageLoaded(f, frameKey[f]);
+                }
+            }
+            lastAccessedFrame = -1;
+            unlockPaging();
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *getReplacementPolicyName() {
+    return replacementPolicy->name;
+}
+
+// Print the active policy, the available policies and the fault counters
+void printPagingStats() {
+    printf("Page replacement policy: %s\n", replacementPolicy->name);
+    printf("Available policies:");
+    for (int i = 0; i < POLICY_COUNT; i++) {
+        printf(" %s", replacementPolicies[i].name);
+    }
+    printf("\nPage faults: %d; Evictions: %d; Shared mappings: %d\n",
+           pageFaultCount, pageEvictionCount, sharedMappingCount);
+    printf("Prefetch limit: %d; Prefetched: %d; Used: %d; Wasted: %d\n",
+           prefetchLimit, prefetchedPageCount, prefetchHitCount, prefetchWasteCount);
+    if (multithreadEnabled) {
+        printf("Coalesced faults: %d; Pin waits: %d\n", coalescedFaultCount, pinWaitCount);
+    }
+}
+
+// Lock the paging state
+void lockPaging() {
+    if (multithreadEnabled) {
+        pthread_mutex_lock(&pagingMutex);
+    }
+}
+
+// Unlock the paging state
+void unlockPaging() {
+    if (multithreadEnabled) {
+        pthread_mutex_unlock(&pagingMutex);
+    }
+}
+
+// Wait for another worker to fill or unpin a frame. The caller holds the paging
+// lock and raised pagingWaiters before testing what it waits for, so an unpin
+// that happens in between still wakes it.
+static void waitForPaging() {
+    pthread_cond_wait(&pagingChanged, &pagingMutex);
+}
+
+static int compareFrameAccess(const void *a, const void *b) {
+    long x = ((const struct FrameAccess *)a)->stamp;
+    long y = ((const struct FrameAccess *)b)->stamp;
+    return (x > y) - (x < y);
+}
+
+// Hand the references stamped since the last victim choice to the replacement
+// policy in the order they happened. Only the frames in the access logs are
+// looked at. The caller holds the paging lock.
+static void applyFrameAccesses() {
+    int count = 0;
+    for (int i = 0; i <= MAX_WORKERS; i++) {
+        struct AccessLog *log = &accessLogs[i];
+        if (__atomic_load_n(&log->count, __ATOMIC_SEQ_CST) == 0) {
+            continue;
+        }
+        pthread_mutex_lock(&log->lock);
+        for (int j = 0; j < log->count; j++) {
+            accessBatch[count++].frameNumber = log->frames[j];
+        }
+        __atomic_store_n(&log->count, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&log->lock);
+    }
+
+    // Clear the mark before reading the stamp: a reference stamped after the
+    // read finds the mark cleared and logs the frame again
+    int applied = 0;
+    for (int i = 0; i < count; i++) {
+        int f = accessBatch[i].frameNumber;
+        __atomic_store_n(&frameLogged[f], 0, __ATOMIC_SEQ_CST);
+        long stamp = __atomic_load_n(&frameAccessStamp[f], __ATOMIC_SEQ_CST);
+        if (stamp > frameAppliedStamp[f] && frameInUse[f] && !frameLoading[f]) {
+            accessBatch[applied].stamp = stamp;
+            accessBatch[applied].frameNumber = f;
+            applied++;
+            frameAppliedStamp[f] = stamp;
+        }
+    }
+    qsort(accessBatch, applied, sizeof(struct FrameAccess), compareFrameAccess);
+    for (int i = 0; i < applied; i++) {
+        replacementPolicy->frameAccessed(accessBatch[i].frameNumber);
+    }
+    lastAccessedFrame = -1;
+}
+
+// Forget the logged references; the replacement policy state is rebuilt
+static void clearFrameAccessLogs() {
+    for (int i = 0; i <= MAX_WORKERS; i++) {
+        for (int j = 0; j < accessLogs[i].count; j++) {
+            frameLogged[accessLogs[i].frames[j]] = 0;
+        }
+        accessLogs[i].count = 0;
+    }
+}
+
+// Pin the frame holding a page of the PCB so no other worker evicts it while
+// the PCB runs a line from it. Only MT workers pin. Returns the frame, or -1 if
+// the page has to be faulted in first.
+int pinPage(struct PCB *pcb, int pageNumber) {
+    int frameNumber = __atomic_load_n(&pcb->pageTable[pageNumber], __ATOMIC_SEQ_CST);
+    if (frameNumber == -1 || !multithreadEnabled) {
+        return frameNumber;
+    }
+    if (__atomic_add_fetch(&framePins[frameNumber], 1, __ATOMIC_SEQ_CST) == 1) {
+        __atomic_add_fetch(&pinnedFrameCount, 1, __ATOMIC_SEQ_CST);
+    }
+    pcb->pinnedFrame = frameNumber;
+
+    // An evicting worker marks the frame loading before it looks at the pins, so
+    // either it sees this pin or this sees the mark
+    if (__atomic_load_n(&frameLoading[frameNumber], __ATOMIC_SEQ_CST)
+        || __atomic_load_n(&pcb->pageTable[pageNumber], __ATOMIC_SEQ_CST) != frameNumber) {
+        unpinFrame(pcb);
+        return -1;
+    }
+    return frameNumber;
+}
+
+// Release the frame pinned by pinPage, waking an evicting worker waiting for it
+void unpinFrame(struct PCB *pcb) {
+    int frameNumber = pcb->pinnedFrame;
+    if (frameNumber == -1) {
+        return;
+    }
+    pcb->pinnedFrame = -1;
+    if (__atomic_sub_fetch(&framePins[frameNumber], 1, __ATOMIC_SEQ_CST) != 0) {
+        return;
+    }
+    __atomic_sub_fetch(&pinnedFrameCount, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pagingWaiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pagingMutex);
+        pthread_cond_broadcast(&pagingChanged);
+        pthread_mutex_unlock(&pagingMutex);
+    }
+}
+
+// Report a reference to a resident frame to the replacement policy
+void accessFrame(int frameNumber) {
+    if (multithreadEnabled) {
+        // Without the paging lock: stamp the frame and let the next eviction
+        // replay it, logging the frame if this is its first reference since
+        long stamp = __atomic_add_fetch(&accessClock, 1, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&frameAccessStamp[frameNumber], stamp, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&frameLogged[frameNumber], __ATOMIC_SEQ_CST) == 0
+            && __atomic_exchange_n(&frameLogged[frameNumber], 1, __ATOMIC_SEQ_CST) == 0) {
+            struct AccessLog *log = &accessLogs[getWorkerId() + 1];
+            pthread_mutex_lock(&log->lock);
+            log->frames[log->count] = frameNumber;
+            __atomic_store_n(&log->count, log->count + 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&log->lock);
+        }
+        return;
+    }
+    if (frameNumber == lastAccessedFrame) {
+        return;  // Consecutive accesses to one frame count as a single reference
+    }
+    lastAccessedFrame = frameNumber;
+    replacementPolicy->frameAccessed(frameNumber);
+}
+
+// FNV-1a hash of a variable name
+static unsigned int hashVariable(const char *var) {
+    unsigned int hash = 2166136261u;
+    for (const char *c = var; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    return hash;
+}
+
+// Segment holding a variable, picked by the top bits of its hash
+static struct VariableSegment *variableSegment(unsigned int hash) {
+    return &variableStore[hash >> (32 - VARIABLE_STRIPE_BITS)];
+}
+
+// Find the slot holding a variable, or the empty slot where it would go.
+// The caller holds the segment lock.
+static struct memory_struct *findVariableSlot(struct VariableSegment *segment, const char *var,
+                                              unsigned int hash) {
+    unsigned int mask = segment->capacity - 1;
+    for (unsigned int i = hash & mask; ; i = (i + 1) & mask) {
+        struct memory_struct *slot = &segment->slots[i];
+        if (slot->var == NULL || (slot->hash == hash && strcmp(slot->var, var) == 0)) {
+            return slot;
+        }
+    }
+}
+
+// Rehash a segment into newCapacity slots. The caller holds the write lock.
+static void rehashVariableSegment(struct VariableSegment *segment, int newCapacity) {
+    struct memory_struct *oldSlots = segment->slots;
+    int oldCapacity = segment->capacity;
+
+    segment->capacity = newCapacity;
+    segment->slots = (struct memory_struct *)calloc(segment->capacity, sizeof(struct memory_struct));
+    for (int i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].var != NULL) {
+            *findVariableSlot(segment, oldSlots[i].var, oldSlots[i].hash) = oldSlots[i];
+        }
+    }
+    free(oldSlots);
+}
+
+// Size the variable store to hold the given number of variables before it has
+// to grow. Variables already set are kept. Returns 0 on success, -1 if invalid.
+int resizeVariableStore(int variables) {
+    if (variables < 1) {
+        return -1;
+    }
+
+    int segmentCapacity = 4;
+    while (segmentCapacity * VARIABLE_STRIPES * 7 / 10 < variables) {
+        segmentCapacity *= 2;
+    }
+    for (int i = 0; i < VARIABLE_STRIPES; i++) {
+        struct VariableSegment *segment = &variableStore[i];
+        pthread_rwlock_wrlock(&segment->lock);
+        int capacity = segmentCapacity;
+        while (segment->count * 10 > capacity * 7) {
+            capacity *= 2;
+        }
+        if (capacity != segment->capacity) {
+            rehashVariableSegment(segment, capacity);
+        }
+        pthread_rwlock_unlock(&segment->lock);
+    }
+    variableStoreSize = variables;
+    return 0;
+}
+
+// Set the value of a variable
+void mem_set_value(char *var_in, char *value_in) {
+    unsigned int hash = hashVariable(var_in);
+    struct VariableSegment *segment = variableSegment(hash);
+    size_t length = strlen(value_in) + 1;
+
+    pthread_rwlock_wrlock(&segment->lock);
+    struct memory_struct *slot = findVariableSlot(segment, var_in, hash);
+
+    if (slot->var == NULL) {
+        // Keep the load factor below 0.7 so probe sequences stay short
+        if ((segment->count + 1) * 10 > segment->capacity * 7) {
+            rehashVariableSegment(segment, segment->capacity * 2);
+            slot = findVariableSlot(segment, var_in, hash);
+        }
+        slot->var = strdup(var_in);
+        slot->hash = hash;
+        slot->value = NULL;
+        slot->valueCapacity = 0;
+        segment->count++;
+    }
+
+    if (length > slot->valueCapacity) {
+        free(slot->value);  // Free the old value
+        slot->value = (char *)malloc(length);
+        slot->valueCapacity = length;
+    }
+    memcpy(slot->value, value_in, length);
+    pthread_rwlock_unlock(&segment->lock);
+}
+
+// Copy the value of a variable into a caller buffer of bufferSize bytes without
+// allocating, truncating if needed. Returns 1 if the variable is set, 0 if not.
+// Copying under the segment's read lock keeps the value consistent while other
+// workers may be setting it.
+int mem_read_value(const char *var_in, char *buffer, size_t bufferSize) {
+    unsigned int hash = hashVariable(var_in);
+    struct VariableSegment *segment = variableSegment(hash);
+    int found = 0;
+
+    pthread_rwlock_rdlock(&segment->lock);
+    struct memory_struct *slot = findVariableSlot(segment, var_in, hash);
+    if (slot->var != NULL) {
+        size_t length = strnlen(slot->value, bufferSize - 1);
+        memcpy(buffer, slot->value, length);
+        buffer[length] = '\0';
+        found = 1;
+    }
+    pthread_rwlock_unlock(&segment->lock);
+    return found;
+}
+
+// Find a free frame
+int findFreeFrame() {
+    if (freeFrameCount == 0) {
+        return -1;  // No free frames
+    }
+    return freeFrames[--freeFrameCount];
+}
+
+// Reserve a range of lineCount lines in script memory; returns its start or -1.
+// The caller holds scriptMemoryMutex.
+static int reserveScriptLines(int lineCount) {
+    if (lineCount == 0) {
+        return memoryIndex;
+    }
+
+    // First fit among the released ranges
+    for (int i = 0; i < freeSegmentCount; i++) {
+        if (freeSegments[i].length >= lineCount) {
+            int start = freeSegments[i].start;
+            freeSegments[i].start += lineCount;
+            freeSegments[i].length -= lineCount;
+            if (freeSegments[i].length == 0) {
+                memmove(&freeSegments[i], &freeSegments[i + 1],
+                        sizeof(struct ScriptSegment) * (freeSegmentCount - i - 1));
+                freeSegmentCount--;
+            }
+            return start;
+        }
+    }
+
+    if (lineCount > MAX_SCRIPTS - memoryIndex || growScriptMemory(memoryIndex + lineCount) == -1) {
+        return -1;
+    }
+    int start = memoryIndex;
+    memoryIndex += lineCount;
+    return start;
+}
+
+// Hand a program's arena of lineCount consecutive NUL-terminated lines to script
+// memory; returns the start index of the program, or -1 (arena freed) if full
+int addScriptLines(char *arena, int lineCount) {
+    lockPaging();
+    pthread_mutex_lock(&scriptMemoryMutex);
+    int start = reserveScriptLines(lineCount);
+    pthread_mutex_unlock(&scriptMemoryMutex);
+    if (start == -1) {
+        unlockPaging();
+        free(arena);
+        return -1;
+    }
+    if (lineCount == 0) {
+        unlockPaging();
+        free(arena);
+        return start;
+    }
+
+    scriptLine(start)->arena = arena;
+    scriptLine(start)->mappingSize = 0;
+    scriptLine(start)->users = 1;
+    char *line = arena;
+    for (int i = 0; i < lineCount; i++) {
+        size_t length = strlen(line);
+        scriptLine(start + i)->text = line;
+        scriptLine(start + i)->length = length < MAX_LINE_LENGTH - 1 ? (int)length : MAX_LINE_LENGTH - 1;
+        line += length + 1;
+    }
+    unlockPaging();
+    return start;
+}
+
+// Length of the line starting at text, split as fgets with a MAX_LINE_LENGTH
+// buffer would: through the newline, or MAX_LINE_LENGTH - 1 bytes at most
+static size_t nextLineLength(const char *text, size_t remaining) {
+    size_t limit = remaining < MAX_LINE_LENGTH - 1 ? remaining : MAX_LINE_LENGTH - 1;
+    const char *newline = memchr(text, '\n', limit);
+    return newline != NULL ? (size_t)(newline - text) + 1 : limit;
+}
+
+// Count the lines of the first size bytes of a file, split as nextLineLength
+// splits them, without moving the file offset
+static int countScriptLines(int fd, size_t size) {
+    char buffer[STREAM_CHUNK_BYTES];
+    int count = 0;
+    size_t lineBytes = 0;  // Bytes of the line in progress
+    size_t offset = 0;
+    while (offset < size) {
+        size_t want = size - offset < sizeof(buffer) ? size - offset : sizeof(buffer);
+        ssize_t bytes = pread(fd, buffer, want, (off_t)offset);
+        if (bytes <= 0) {
+            break;  // The file shrank or cannot be read; the loader stops there too
+        }
+        const char *text = buffer;
+        const char *end = buffer + bytes;
+        while (text < end) {
+            size_t limit = MAX_LINE_LENGTH - 1 - lineBytes;
+            size_t available = (size_t)(end - text);
+            const char *newline = memchr(text, '\n', available < limit ? available : limit);
+            if (newline != NULL) {
+                text = newline + 1;
+            } else if (available >= limit) {
+                text += limit;
+            } else {
+                lineBytes += available;
+                break;
+            }
+            count++;
+            lineBytes = 0;
+        }
+        offset += (size_t)bytes;
+    }
+    return lineBytes > 0 ? count + 1 : count;
+}
+
+// Map a backing store file read-only and index its lines into script memory.
+// Page faults copy lines straight from the mapping, so the script text is never
+// held on the heap; the kernel pages the file in and out of the mapping as
+// needed. Returns the start index and sets lineCount, -1 if the file cannot be
+// mapped, or -2 if script memory is full.
+static int mapScriptLines(int fd, int *lineCount) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        *lineCount = 0;
+        return memoryIndex;
+    }
+    char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    // Count the lines, then index them in the reserved range
+    int count = 0;
+    for (size_t offset = 0; offset < size; offset += nextLineLength(base + offset, size - offset)) {
+        count++;
+    }
+    pthread_mutex_lock(&scriptMemoryMutex);
+    int start = reserveScriptLines(count);
+    pthread_mutex_unlock(&scriptMemoryMutex);
+    if (start == -1) {
+        munmap(base, size);
+        return -2;
+    }
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        size_t length = nextLineLength(base + offset, size - offset);
+        scriptLine(start + i)->text = base + offset;
+        scriptLine(start + i)->length = (int)length;
+        offset += length;
+    }
+    scriptLine(start)->arena = base;
+    scriptLine(start)->mappingSize = size;
+    scriptLine(start)->users = 1;
+
+    // Building the index touched the whole file; let those pages go
+    madvise(base, size, MADV_DONTNEED);
+    *lineCount = count;
+    return start;
+}
+
+// After pages are read, drop the process's view of the part of a mapped script
+// that holds their lines: frames keep their own copies, so resident memory stays
+// bounded by the frame store rather than by the size of the scripts
+static void releaseMappedPages(struct PCB *pcb, int firstPage, int pageCount) {
+    size_t mappingSize = scriptLine(pcb->start)->mappingSize;
+    if (mappingSize == 0) {
+        return;
+    }
+    int first = pcb->start + firstPage * frameSize;
+    int last = first + pageCount * frameSize;
+    if (last > pcb->start + pcb->length) {
+        last = pcb->start + pcb->length;
+    }
+    if (first >= last) {
+        return;
+    }
+
+    // The mapping is page aligned and spans whole pages, so rounding out stays inside it
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t from = (uintptr_t)scriptLine(first)->text & ~(pageSize - 1);
+    uintptr_t to = ((uintptr_t)scriptLine(last - 1)->text + scriptLine(last - 1)->length + pageSize - 1) & ~(pageSize - 1);
+    madvise((void *)from, to - from, MADV_DONTNEED);
+}
+
+// Let go of a program's lines. The last load using them frees them in one
+// operation and makes the range reusable.
+void releaseScriptLines(int start, int lineCount) {
+    if (lineCount <= 0 || scriptLine(start)->arena == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&scriptMemoryMutex);
+    int users = --scriptLine(start)->users;
+    pthread_mutex_unlock(&scriptMemoryMutex);
+    if (users > 0) {
+        return;
+    }
+    if (scriptLine(start)->mappingSize > 0) {
+        munmap(scriptLine(start)->arena, scriptLine(start)->mappingSize);
+        scriptLine(start)->mappingSize = 0;
+    } else {
+        free(scriptLine(start)->arena);
+    }
+    scriptLine(start)->arena = NULL;
+    for (int i = 0; i < lineCount; i++) {
+        scriptLine(start + i)->text = NULL;
+        scriptLine(start + i)->length = 0;
+    }
+    swapCacheInvalidate(start, lineCount);
+
+    pthread_mutex_lock(&scriptMemoryMutex);
+    freeScriptRange(start, lineCount);
+    pthread_mutex_unlock(&scriptMemoryMutex);
+}
+
+// Make a range of script memory reusable. The caller holds scriptMemoryMutex.
+static void freeScriptRange(int start, int lineCount) {
+    // Insert the range in start order, merging with its neighbours
+    int i = 0;
+    while (i < freeSegmentCount && freeSegments[i].start < start) {
+        i++;
+    }
+    if (i > 0 && freeSegments[i - 1].start + freeSegments[i - 1].length == start) {
+        i--;
+        freeSegments[i].length += lineCount;
+    } else {
+        if (freeSegmentCount == freeSegmentCapacity) {
+            freeSegmentCapacity = freeSegmentCapacity > 0 ? freeSegmentCapacity * 2 : 64;
+            freeSegments = (struct ScriptSegment *)realloc(freeSegments,
+                                                           sizeof(struct ScriptSegment) * freeSegmentCapacity);
+        }
+        memmove(&freeSegments[i + 1], &freeSegments[i],
+                sizeof(struct ScriptSegment) * (freeSegmentCount - i));
+        freeSegments[i].start = start;
+        freeSegments[i].length = lineCount;
+        freeSegmentCount++;
+    }
+    if (i + 1 < freeSegmentCount
+        && freeSegments[i].start + freeSegments[i].length == freeSegments[i + 1].start) {
+        freeSegments[i].length += freeSegments[i + 1].length;
+        memmove(&freeSegments[i + 1], &freeSegments[i + 2],
+                sizeof(struct ScriptSegment) * (freeSegmentCount - i - 2));
+        freeSegmentCount--;
+    }
+
+    // A range at the top of script memory lowers memoryIndex instead
+    if (i == freeSegmentCount - 1 && freeSegments[i].start + freeSegments[i].length == memoryIndex) {
+        memoryIndex = freeSegments[i].start;
+        freeSegmentCount--;
+    }
+}
+
+// Load a page into a frame by copying its lines into the frame's slots.
+// Lines at or past scriptEnd belong to another program and are left empty.
+void loadPageIntoFrame(int scriptStart, int scriptEnd, int pageNumber, int frameNumber) {
+    int lineNumber = scriptStart + pageNumber * frameSize;
+    for (int i = 0; i < frameSize; i++) {
+        char *slot = frameLine(frameNumber, i);
+        if (lineNumber + i < scriptEnd && scriptLine(lineNumber + i)->text != NULL) {
+            size_t length = scriptLine(lineNumber + i)->length;
+            memcpy(slot, scriptLine(lineNumber + i)->text, length);
+            slot[length] = '\0';
+        } else {
+            slot[0] = '\0'; // Empty line
+        }
+    }
+    // Do not update the replacement policy here
+}
+
+// FNV-1a hash of the lines a page would hold, as stored in a frame
+static long pageContentHash(int scriptStart, int scriptEnd, int pageNumber) {
+    unsigned long hash = 14695981039346656037UL;
+    int lineNumber = scriptStart + pageNumber * frameSize;
+    for (int i = 0; i < frameSize && lineNumber + i < scriptEnd; i++) {
+        const char *line = scriptLine(lineNumber + i)->text;
+        for (int c = 0; line != NULL && c < scriptLine(lineNumber + i)->length; c++) {
+            hash = (hash ^ (unsigned char)line[c]) * 1099511628211UL;
+        }
+        hash = (hash ^ 0xff) * 1099511628211UL;  // Line separator
+    }
+    return (long)(hash & 0x7fffffffffffffffUL);
+}
+
+// Check that a frame holds exactly the lines of a page
+static int frameHoldsPage(int frameNumber, int scriptStart, int scriptEnd, int pageNumber) {
+    int lineNumber = scriptStart + pageNumber * frameSize;
+    for (int i = 0; i < frameSize; i++) {
+        const char *line = lineNumber + i < scriptEnd ? scriptLine(lineNumber + i)->text : NULL;
+        const char *slot = frameLine(frameNumber, i);
+        if (line == NULL) {
+            if (slot[0] != '\0') return 0;
+        } else {
+            size_t length = scriptLine(lineNumber + i)->length;
+            if (memcmp(slot, line, length) != 0 || slot[length] != '\0') return 0;
+        }
+    }
+    return 1;
+}
+
+static int contentBucket(long hash) {
+    return (int)((unsigned long)hash % (2 * frameCount));
+}
+
+// Index a frame under the hash of the page it now holds
+static void indexFrameContent(int frameNumber) {
+    int bucket = contentBucket(frameKey[frameNumber]);
+    frameHashNext[frameNumber] = contentBuckets[bucket];
+    contentBuckets[bucket] = frameNumber;
+}
+
+// Remove a frame from the content index
+static void unindexFrameContent(int frameNumber) {
+    int *link = &contentBuckets[contentBucket(frameKey[frameNumber])];
+    while (*link != -1 && *link != frameNumber) {
+        link = &frameHashNext[*link];
+    }
+    if (*link == frameNumber) {
+        *link = frameHashNext[frameNumber];
+    }
+    frameHashNext[frameNumber] = -1;
+}
+
+// Find a resident frame already holding the given page content, -1 if none
+static int findSharedFrame(long hash, int scriptStart, int scriptEnd, int pageNumber) {
+    for (int f = contentBuckets[contentBucket(hash)]; f != -1; f = frameHashNext[f]) {
+        if (frameKey[f] == hash && !frameLoading[f] && frameHoldsPage(f, scriptStart, scriptEnd, pageNumber)) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+// Record that a PCB's page is now held in a frame, adding the PCB to the
+// frame's chain of sharers
+static void mapFrame(struct PCB *pcb, int pageNumber, int frameNumber) {
+    __atomic_store_n(&pcb->pageTable[pageNumber], frameNumber, __ATOMIC_SEQ_CST);
+    pcb->pages_loaded++;
+    struct PCB *owner = frameOwner[frameNumber];
+    pcb->pageSharers[pageNumber].pcb = owner;
+    pcb->pageSharers[pageNumber].page = frameOwnerPage[frameNumber];
+    pcb->pageSharers[pageNumber].prevPcb = NULL;
+    if (owner != NULL) {
+        owner->pageSharers[frameOwnerPage[frameNumber]].prevPcb = pcb;
+        owner->pageSharers[frameOwnerPage[frameNumber]].prevPage = pageNumber;
+    }
+    if (frameRefCount[frameNumber] == 1) {
+        owner->privateFrames--;  // Now shared with this PCB
+    }
+    frameOwner[frameNumber] = pcb;
+    frameOwnerPage[frameNumber] = pageNumber;
+    frameRefCount[frameNumber]++;
+    if (frameRefCount[frameNumber] == 1) {
+        pcb->privateFrames++;
+    }
+}
+
+// Invalidate every page table entry that maps to an evicted frame
+void updatePageTables(int evictedFrameNumber) {
+    struct PCB *pcb = frameOwner[evictedFrameNumber];
+    int pageNumber = frameOwnerPage[evictedFrameNumber];
+    if (frameRefCount[evictedFrameNumber] == 1) {
+        pcb->privateFrames--;
+    }
+    while (pcb != NULL) {
+        struct PageSharer next = pcb->pageSharers[pageNumber];
+        __atomic_store_n(&pcb->pageTable[pageNumber], -1, __ATOMIC_SEQ_CST);  // Mark page as not loaded
+        pcb->pages_loaded--;
+        pcb->pageSharers[pageNumber].pcb = NULL;
+        pcb->pageSharers[pageNumber].prevPcb = NULL;
+        pcb = next.pcb;
+        pageNumber = next.page;
+    }
+    frameOwner[evictedFrameNumber] = NULL;
+    frameOwnerPage[evictedFrameNumber] = -1;
+    frameRefCount[evictedFrameNumber] = 0;
+}
+
+// Drop a PCB's mappings before the PCB is freed. Frames it no longer shares
+// with anyone stay resident so a later run of the same script can reuse them.
+void releasePCBFrames(struct PCB *pcb) {
+    if (pcb->pageTable == NULL || pcb->pageSharers == NULL) {
+        return;
+    }
+    for (int i = 0; i < pcb->pages_max; i++) {
+        int frameNumber = pcb->pageTable[i];
+        if (frameNumber == -1) {
+            continue;
+        }
+
+        if (frameRefCount[frameNumber] == 1) {
+            pcb->privateFrames--;
+        }
+
+        // Unlink (pcb, i) from the frame's chain of sharers
+        struct PageSharer *entry = &pcb->pageSharers[i];
+        if (entry->prevPcb != NULL) {
+            entry->prevPcb->pageSharers[entry->prevPage].pcb = entry->pcb;
+            entry->prevPcb->pageSharers[entry->prevPage].page = entry->page;
+        } else {
+            frameOwner[frameNumber] = entry->pcb;
+            frameOwnerPage[frameNumber] = entry->pcb != NULL ? entry->page : -1;
+        }
+        if (entry->pcb != NULL) {
+            entry->pcb->pageSharers[entry->page].prevPcb = entry->prevPcb;
+            entry->pcb->pageSharers[entry->page].prevPage = entry->prevPage;
+        }
+        frameRefCount[frameNumber]--;
+        if (frameRefCount[frameNumber] == 1) {
+            frameOwner[frameNumber]->privateFrames++;  // The last sharer left holds it alone
+        }
+        pcb->pageTable[i] = -1;
+        pcb->pages_loaded--;
+        entry->pcb = NULL;
+        entry->prevPcb = NULL;
+    }
+}
+
+static int swapBucket(int lineIndex) {
+    return (int)(((unsigned int)lineIndex * 2654435761u) % SWAP_CACHE_BUCKETS);
+}
+
+// Unlink an entry from the cache; the caller frees it
+static void swapCacheUnlink(struct SwapEntry *entry) {
+    struct SwapEntry **link = &swapBuckets[swapBucket(entry->lineIndex)];
+    while (*link != entry) {
+        link = &(*link)->hashNext;
+    }
+    *link = entry->hashNext;
+
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        swapCacheHead = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        swapCacheTail = entry->prev;
+    }
+    swapCacheUsed -= entry->size;
+    swapCacheEntries--;
+}
+
+static struct SwapEntry *swapCacheFind(int lineIndex) {
+    for (struct SwapEntry *entry = swapBuckets[swapBucket(lineIndex)]; entry != NULL; entry = entry->hashNext) {
+        if (entry->lineIndex == lineIndex) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Drop every cached page
+static void swapCacheClear() {
+    while (swapCacheHead != NULL) {
+        struct SwapEntry *entry = swapCacheHead;
+        swapCacheUnlink(entry);
+        free(entry);
+    }
+}
+
+// Drop the cached pages that start in a range of script lines
+static void swapCacheInvalidate(int start, int lineCount) {
+    struct SwapEntry *entry = swapCacheHead;
+    while (entry != NULL) {
+        struct SwapEntry *next = entry->next;
+        if (entry->lineIndex >= start && entry->lineIndex < start + lineCount) {
+            swapCacheUnlink(entry);
+            free(entry);
+        }
+        entry = next;
+    }
+}
+
+// Compress the page in an evicted frame into the cache, making room by
+// dropping the oldest entries. Pages of finished programs are not kept.
+static void swapCacheStore(int frameNumber) {
+    struct PCB *owner = frameOwner[frameNumber];
+    if (swapCacheCapacity == 0 || owner == NULL) {
+        return;
+    }
+    int lineIndex = owner->start + frameOwnerPage[frameNumber] * frameSize;
+
+    int packedSize = 0;
+    for (int i = 0; i < frameSize; i++) {
+        const char *slot = frameLine(frameNumber, i);
+        size_t length = strnlen(slot, MAX_LINE_LENGTH - 1);
+        memcpy(swapStoreBuffer + packedSize, slot, length);
+        packedSize += length;
+        swapStoreBuffer[packedSize++] = '\0';
+    }
+    int size = compressBlock(swapStoreBuffer, packedSize, swapCompressBuffer, packedSize);
+    if (size == 0 || size > swapCacheCapacity) {
+        swapRejectCount++;
+        return;
+    }
+
+    struct SwapEntry *stale = swapCacheFind(lineIndex);
+    if (stale != NULL) {
+        swapCacheUnlink(stale);
+        free(stale);
+    }
+    while (swapCacheUsed + size > swapCacheCapacity) {
+        struct SwapEntry *oldest = swapCacheHead;
+        swapCacheUnlink(oldest);
+        free(oldest);
+    }
+
+    struct SwapEntry *entry = (struct SwapEntry *)malloc(sizeof(struct SwapEntry) + size);
+    entry->lineIndex = lineIndex;
+    entry->key = frameKey[frameNumber];
+    entry->packedSize = packedSize;
+    entry->size = size;
+    memcpy(entry->data, swapCompressBuffer, size);
+
+    int bucket = swapBucket(lineIndex);
+    entry->hashNext = swapBuckets[bucket];
+    swapBuckets[bucket] = entry;
+    entry->prev = swapCacheTail;
+    entry->next = NULL;
+    if (swapCacheTail != NULL) {
+        swapCacheTail->next = entry;
+    } else {
+        swapCacheHead = entry;
+    }
+    swapCacheTail = entry;
+    swapCacheUsed += size;
+    swapCacheEntries++;
+    swapStoreCount++;
+    swapPackedBytes += packedSize;
+    swapCompressedBytes += size;
+}
+
+// Take the cached copy of the page starting at a script line out of the cache.
+// Returns the page decompressed and sets the content hash on a hit, NULL on a
+// miss. MT workers may release the paging lock before they unpack the page, so
+// each gets its own buffer, which the caller frees; otherwise it is
+// swapLoadBuffer.
+static unsigned char *swapCacheLoad(int lineIndex, long *key) {
+    struct SwapEntry *entry = swapCacheCapacity > 0 ? swapCacheFind(lineIndex) : NULL;
+    if (entry == NULL) {
+        return NULL;
+    }
+    swapCacheUnlink(entry);
+    unsigned char *packed = multithreadEnabled ? (unsigned char *)malloc(swapBufferSize) : swapLoadBuffer;
+    int packedSize = decompressBlock(entry->data, entry->size, packed, swapBufferSize);
+    *key = entry->key;
+    if (packedSize != entry->packedSize) {
+        if (packed != swapLoadBuffer) {
+            free(packed);
+        }
+        packed = NULL;
+    }
+    free(entry);
+    return packed;
+}
+
+// Check that a frame holds exactly the lines of a packed page
+static int frameHoldsPacked(int frameNumber, const unsigned char *packed) {
+    const char *line = (const char *)packed;
+    for (int i = 0; i < frameSize; i++) {
+        if (strcmp(frameLine(frameNumber, i), line) != 0) return 0;
+        line += strlen(line) + 1;
+    }
+    return 1;
+}
+
+// Copy the lines of a packed page into a frame's slots
+static void unpackPageIntoFrame(const unsigned char *packed, int frameNumber) {
+    const char *line = (const char *)packed;
+    for (int i = 0; i < frameSize; i++) {
+        size_t length = strlen(line);
+        memcpy(frameLine(frameNumber, i), line, length + 1);
+        line += length + 1;
+    }
+}
+
+// Set the swap cache capacity in bytes; 0 disables and empties the cache
+void setSwapCacheCapacity(int bytes) {
+    lockPaging();
+    swapCacheCapacity = bytes;
+    while (swapCacheUsed > swapCacheCapacity) {
+        struct SwapEntry *oldest = swapCacheHead;
+        swapCacheUnlink(oldest);
+        free(oldest);
+    }
+    unlockPaging();
+}
+
+// Print the swap cache capacity, use and hit rate
+void printSwapCacheStats() {
+    int lookups = swapHitCount + swapMissCount;
+    printf("Swap cache: %d of %d bytes in %d pages; Stored: %d; Rejected: %d\n",
+           swapCacheUsed, swapCacheCapacity, swapCacheEntries, swapStoreCount, swapRejectCount);
+    printf("Swap cache hits: %d; Misses: %d; Hit rate: %d%%; Compressed size: %d%%\n",
+           swapHitCount, swapMissCount, lookups > 0 ? swapHitCount * 100 / lookups : 0,
+           swapPackedBytes > 0 ? (int)(swapCompressedBytes * 100 / swapPackedBytes) : 0);
+}
+
+// Evict the frame chosen by the replacement policy
+int evictFrame(long incomingKey) {
+    if (multithreadEnabled) {
+        applyFrameAccesses();
+    }
+    int victimFrame = replacementPolicy->selectVictim(incomingKey);
+    if (victimFrame == -1 && victimMode != VICTIM_ANY) {
+        // Every frame of the kind asked for is pinned or being filled
+        victimMode = VICTIM_ANY;
+        victimFrame = replacementPolicy->selectVictim(incomingKey);
+    }
+
+    if (victimFrame == -1) {
+        // No frame to evict; handle error
+        printf("Error: No frames to evict.\n");
+        exit(1);
+    }
+    setFrameLoading(victimFrame, 1);  // No new pins
+
+    // Print the message indicating eviction
+    printf("Page fault! Victim page contents:\n\n");
+
+    // Print the victim page contents; the slots are overwritten by the next page-in
+    for (int i = 0; i < frameSize; i++) {
+        const char *slot = frameLine(victimFrame, i);
+        if (slot[0] != '\0') {
+            printf("%s", slot);
+        }
+    }
+
+    printf("\nEnd of victim page contents.\n");
+
+    swapCacheStore(victimFrame);
+
+    // A prefetched page evicted before use was wasted read-ahead
+    if (__atomic_exchange_n(&framePrefetched[victimFrame], 0, __ATOMIC_RELAXED)) {
+        prefetchWasteCount++;
+        if (frameOwner[victimFrame] != NULL) {
+            struct PCB *owner = frameOwner[victimFrame];
+            __atomic_store_n(&owner->prefetchWindow, __atomic_load_n(&owner->prefetchWindow, __ATOMIC_RELAXED) / 2,
+                             __ATOMIC_RELAXED);
+        }
+    }
+
+    unindexFrameContent(victimFrame);
+    frameInUse[victimFrame] = 0; // Mark the frame as unused
+    frameKey[victimFrame] = -1;
+    if (lastAccessedFrame == victimFrame) {
+        lastAccessedFrame = -1;
+    }
+    pageEvictionCount++;
+
+    // Invalidate the owner's page table entry
+    updatePageTables(victimFrame);
+
+    // A worker that pinned the frame just before it was chosen may still be
+    // running a line from it; the slots are overwritten once it is done
+    if (multithreadEnabled) {
+        __atomic_add_fetch(&pagingWaiters, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&framePins[victimFrame], __ATOMIC_SEQ_CST) > 0) {
+            pinWaitCount++;
+            waitForPaging();
+        }
+        __atomic_sub_fetch(&pagingWaiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return victimFrame;
+}
+
+// Whether the store is full of frames no policy may evict. Frames both pinned
+// and loading are counted twice, so only when the counts cover the store are
+// the frames checked one by one.
+static int noVictimAvailable() {
+    if (freeFrameCount > 0
+        || loadingFrameCount + __atomic_load_n(&pinnedFrameCount, __ATOMIC_SEQ_CST) < frameCount) {
+        return 0;
+    }
+    for (int f = 0; f < frameCount; f++) {
+        if (frameInUse[f] && victimAllowed(f)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Find a frame for a new page of a PCB: one of its own pages when it is at its
+// quota, else a free frame, else one evicted by the replacement policy. A fault
+// announces itself unless eviction already printed the victim.
+static int allocatePageFrame(struct PCB *pcb, long key, int announceFault) {
+    int frameNumber;
+
+    // Every other frame may be on its way in; wait for one to land
+    while (pageInsOutstanding > 0 && noVictimAvailable()) {
+        finishPageIns(1);
+    }
+    if (multithreadEnabled) {
+        // Every frame may be pinned or being filled by the other workers
+        __atomic_add_fetch(&pagingWaiters, 1, __ATOMIC_SEQ_CST);
+        while (noVictimAvailable()) {
+            waitForPaging();
+        }
+        __atomic_sub_fetch(&pagingWaiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+    if (frameQuotaMode != QUOTA_NONE && pcb->pages_loaded >= pcb->frameQuota && pcb->privateFrames > 0) {
+        // At its quota: replace one of the process's own pages
+        victimMode = VICTIM_LOCAL;
+        victimPCB = pcb;
+        frameNumber = evictFrame(key);
+        localReplacementCount++;
+    } else {
+        frameNumber = findFreeFrame();
+        if (frameNumber != -1) {
+            if (announceFault) {
+                printf("Page fault!\n");
+            }
+        } else {
+            // No free frame, eviction is needed. Prefer spare frames; with
+            // none to pick, evictFrame falls back to any frame.
+            if (frameQuotaMode != QUOTA_NONE) {
+                victimMode = VICTIM_SPARE;
+                victimPCB = pcb;
+            }
+            frameNumber = evictFrame(key);
+        }
+    }
+    victimMode = VICTIM_ANY;
+    setFrameLoading(frameNumber, 1);
+    return frameNumber;
+}
+
+// Map a page of a PCB to a frame already holding its content, or place it in a
+// free or evicted frame. A fault announces itself unless eviction already
+// printed the victim.
+static int installPage(struct PCB *pcb, int pageNumber, int announceFault) {
+    int scriptEnd = pcb->start + pcb->length;
+    long key;
+    unsigned char *packed = swapCacheLoad(pcb->start + pageNumber * frameSize, &key);
+    int cached = packed != NULL;
+    if (!cached) {
+        key = pageContentHash(pcb->start, scriptEnd, pageNumber);
+    }
+
+    int frameNumber = -1;
+    int waited = 0;
+    int f = contentBuckets[contentBucket(key)];
+    while (f != -1 && frameNumber == -1) {
+        if (frameKey[f] == key && frameLoading[f]) {
+            // Another worker is reading the same content in; share its copy
+            if (!waited) {
+                coalescedFaultCount++;
+                waited = 1;
+            }
+            waitForPaging();
+            f = contentBuckets[contentBucket(key)];
+            continue;
+        }
+        if (frameKey[f] == key && (cached ? frameHoldsPacked(f, packed)
+                                          : frameHoldsPage(f, pcb->start, scriptEnd, pageNumber))) {
+            frameNumber = f;
+        }
+        f = frameHashNext[f];
+    }
+    if (frameNumber != -1) {
+        if (announceFault) {
+            printf("Page fault!\n");
+        }
+        if (frameRefCount[frameNumber] > 0) {
+            sharedMappingCount++;
+        }
+        mapFrame(pcb, pageNumber, frameNumber);
+        accessFrame(frameNumber);
+        if (!cached) {
+            releaseMappedPages(pcb, pageNumber, 1);
+        } else if (packed != swapLoadBuffer) {
+            free(packed);
+        }
+        return frameNumber;
+    }
+
+    frameNumber = allocatePageFrame(pcb, key, announceFault);
+    frameInUse[frameNumber] = 1;
+    frameKey[frameNumber] = key;
+    indexFrameContent(frameNumber);
+
+    if (cached) {
+        unpackPageIntoFrame(packed, frameNumber);
+        if (packed != swapLoadBuffer) {
+            free(packed);
+        }
+        swapHitCount++;
+    } else if (multithreadEnabled) {
+        // Copy without the lock; workers faulting on this content wait for it
+        unlockPaging();
+        loadPageIntoFrame(pcb->start, scriptEnd, pageNumber, frameNumber);
+        releaseMappedPages(pcb, pageNumber, 1);
+        lockPaging();
+        if (swapCacheCapacity > 0) {
+            swapMissCount++;
+        }
+    } else {
+        loadPageIntoFrame(pcb->start, scriptEnd, pageNumber, frameNumber);
+        releaseMappedPages(pcb, pageNumber, 1);
+        if (swapCacheCapacity > 0) {
+            swapMissCount++;
+        }
+    }
+
+    // Update the page table and the inverted page table
+    setFrameLoading(frameNumber, 0);  // Pins may take it again
+    mapFrame(pcb, pageNumber, frameNumber);
+
+    __atomic_store_n(&framePrefetched[frameNumber], 0, __ATOMIC_RELAXED);
+    frameAppliedStamp[frameNumber] = __atomic_load_n(&frameAccessStamp[frameNumber], __ATOMIC_RELAXED);
+    lastAccessedFrame = frameNumber;
+    replacementPolicy->pageLoaded(frameNumber, key);
+    if (multithreadEnabled) {
+        pthread_cond_broadcast(&pagingChanged);
+    }
+    return frameNumber;
+}
+
+// Loader thread: fill reserved frames from the backing store in request order
+static void *pageInLoader(void *arg) {
+    for (;;) {
+        pthread_mutex_lock(&pageInMutex);
+        while (pageInQueueHead == NULL) {
+            pthread_cond_wait(&pageInQueued, &pageInMutex);
+        }
+        struct PageInRequest *request = pageInQueueHead;
+        pageInQueueHead = request->next;
+        if (pageInQueueHead == NULL) {
+            pageInQueueTail = NULL;
+        }
+        pthread_mutex_unlock(&pageInMutex);
+
+        struct PCB *pcb = request->pcb;
+        int scriptEnd = pcb->start + pcb->length;
+        request->key = pageContentHash(pcb->start, scriptEnd, request->pageNumber);
+        loadPageIntoFrame(pcb->start, scriptEnd, request->pageNumber, request->frameNumber);
+        releaseMappedPages(pcb, request->pageNumber, 1);
+
+        pthread_mutex_lock(&pageInMutex);
+        request->next = NULL;
+        if (pageInDoneTail != NULL) {
+            pageInDoneTail->next = request;
+        } else {
+            pageInDoneHead = request;
+        }
+        pageInDoneTail = request;
+        pthread_cond_signal(&pageInFinished);
+        pthread_mutex_unlock(&pageInMutex);
+    }
+    return NULL;
+}
+
+// Check that two frames hold the same lines
+static int framesEqual(int a, int b) {
+    for (int i = 0; i < frameSize; i++) {
+        if (strcmp(frameLine(a, i), frameLine(b, i)) != 0) return 0;
+    }
+    return 1;
+}
+
+// Start a page fault without waiting for the backing store. Pages in the swap
+// cache or already resident are installed at once and 0 is returned; otherwise
+// a frame is reserved, the read is queued to the loader thread, the PCB's
+// pendingPage is set and 1 is returned. Read-ahead is not done for these faults.
+int requestPageIn(struct PCB *pcb, int pageNumber) {
+    waitForScriptLines(pcb, (pageNumber + 1) * frameSize);
+    pageFaultCount++;
+    if (frameQuotaMode == QUOTA_PFF) {
+        adjustFaultQuota(pcb);
+    }
+    int scriptEnd = pcb->start + pcb->length;
+    int lineIndex = pcb->start + pageNumber * frameSize;
+    if (swapCacheCapacity > 0 && swapCacheFind(lineIndex) != NULL) {
+        installPage(pcb, pageNumber, 1);  // Decompressing is not worth a thread hop
+        return 0;
+    }
+
+    // Content already resident: a shared mapping needs no read
+    long key = pageContentHash(pcb->start, scriptEnd, pageNumber);
+    int frameNumber = findSharedFrame(key, pcb->start, scriptEnd, pageNumber);
+    if (frameNumber != -1) {
+        installPage(pcb, pageNumber, 1);
+        return 0;
+    }
+
+    if (!loaderStarted) {
+        pthread_create(&loaderThread, NULL, pageInLoader, NULL);
+        pthread_detach(loaderThread);
+        loaderStarted = 1;
+    }
+
+    frameNumber = allocatePageFrame(pcb, key, 1);
+    frameInUse[frameNumber] = 1;
+    setFrameLoading(frameNumber, 1);
+    frameKey[frameNumber] = -1;
+    framePrefetched[frameNumber] = 0;
+    if (swapCacheCapacity > 0) {
+        swapMissCount++;
+    }
+
+    struct PageInRequest *request = (struct PageInRequest *)malloc(sizeof(struct PageInRequest));
+    request->pcb = pcb;
+    request->pageNumber = pageNumber;
+    request->frameNumber = frameNumber;
+    request->next = NULL;
+    pcb->pendingPage = pageNumber;
+    pageInsOutstanding++;
+    asyncPageInCount++;
+
+    pthread_mutex_lock(&pageInMutex);
+    if (pageInQueueTail != NULL) {
+        pageInQueueTail->next = request;
+    } else {
+        pageInQueueHead = request;
     }
+    pageInQueueTail = request;
+    pthread_cond_signal(&pageInQueued);
+    pthread_mutex_unlock(&pageInMutex);
+    return 1;
+}
 
-    // Initialize frame storage area
-    for (i = 0; i < FRAME_COUNT * FRAME_SIZE; i++) {
-        frameStore[i] = NULL;
+// Install the pages the loader has finished, clearing their PCBs' pendingPage.
+// With wait set, block until at least one finishes if any is outstanding.
+// Returns the number of page-ins installed.
+int finishPageIns(int wait) {
+    if (pageInsOutstanding == 0) {
+        return 0;
     }
-    for (i = 0; i < FRAME_COUNT; i++) {
-        frameUsage[i] = -1;  // Mark frame as unused
+
+    pthread_mutex_lock(&pageInMutex);
+    if (wait && pageInDoneHead == NULL) {
+        pageInWaitCount++;
+        while (pageInDoneHead == NULL) {
+            pthread_cond_wait(&pageInFinished, &pageInMutex);
+        }
     }
-    currentTime = 0;
+    struct PageInRequest *request = pageInDoneHead;
+    pageInDoneHead = NULL;
+    pageInDoneTail = NULL;
+    pthread_mutex_unlock(&pageInMutex);
 
-    // Initialize script memory
-    for (i = 0; i < MAX_SCRIPTS; i++) {
-        scriptMemory[i] = NULL;
+    int finished = 0;
+    while (request != NULL) {
+        struct PageInRequest *next = request->next;
+        struct PCB *pcb = request->pcb;
+        int frameNumber = request->frameNumber;
+        setFrameLoading(frameNumber, 0);
+
+        // The same content may have become resident while this copy loaded
+        int existing = -1;
+        for (int f = contentBuckets[contentBucket(request->key)]; f != -1 && existing == -1; f = frameHashNext[f]) {
+            if (frameKey[f] == request->key && framesEqual(f, frameNumber)) {
+                existing = f;
+            }
+        }
+        if (existing != -1) {
+            frameInUse[frameNumber] = 0;
+            freeFrames[freeFrameCount++] = frameNumber;
+            if (frameRefCount[existing] > 0) {
+                sharedMappingCount++;
+            }
+            mapFrame(pcb, request->pageNumber, existing);
+            accessFrame(existing);
+        } else {
+            mapFrame(pcb, request->pageNumber, frameNumber);
+            frameKey[frameNumber] = request->key;
+            indexFrameContent(frameNumber);
+            replacementPolicy->pageLoaded(frameNumber, request->key);
+        }
+        pcb->pendingPage = -1;
+        pageInsOutstanding--;
+        finished++;
+        free(request);
+        request = next;
     }
+    return finished;
+}
 
-    // Other initialization...
+// Choose between synchronous and asynchronous page-in
+void setAsyncPageIn(int enabled) {
+    asyncPageIn = enabled;
 }
 
-// Update the last access time of a frame
-void accessFrame(int frameNumber) {
-    currentTime++;
-    frameUsage[frameNumber] = currentTime;  // Update access time
+int isAsyncPageIn() {
+    return asyncPageIn;
 }
 
-// Set the value of a variable
-void mem_set_value(char *var_in, char *value_in) {
-    int i;
+// Print the page-in mode and how often the scheduler had to wait for the loader
+void printPageInStats() {
+    printf("Page-in: %s; Asynchronous page-ins: %d; Scheduler waits: %d\n",
+           asyncPageIn ? "async" : "sync", asyncPageInCount, pageInWaitCount);
+}
+
+// Processes whose quotas are set: loaded and not yet finished
+static int hasFrameQuota(struct PCB *pcb) {
+    return pcb->pageLastUse != NULL && (pcb->pc < pcb->length || !pcb->lengthFinal);
+}
+
+// Recompute the frame quota of every process for the current mode; PFF starts
+// from an equal share. Called when processes are loaded or destroyed and when
+// the frame store or the mode changes.
+void updateFrameQuotas() {
+    if (frameQuotaMode == QUOTA_NONE) {
+        return;
+    }
 
-    // Search if the variable already exists
-    for (i = 0; i < VARIABLE_STORE_SIZE; i++) {
-        if (variableStore[i].var != NULL && strcmp(variableStore[i].var, var_in) == 0) {
-            free(variableStore[i].value);  // Free the old value
-            variableStore[i].value = strdup(value_in);
-            return;
+    int processes = 0;
+    long totalPages = 0;
+    for (struct PCB *pcb = getLivePCBs(); pcb != NULL; pcb = pcb->liveNext) {
+        if (hasFrameQuota(pcb)) {
+            processes++;
+            totalPages += pcb->pages_max;
         }
     }
+    totalFrameQuota = 0;
+    if (processes == 0) {
+        return;
+    }
 
-    // If the variable does not exist, find an empty slot
-    for (i = 0; i < VARIABLE_STORE_SIZE; i++) {
-        if (variableStore[i].var == NULL) {
-            variableStore[i].var = strdup(var_in);
-            variableStore[i].value = strdup(value_in);
-            return;
+    int remainder = frameCount % processes;
+    for (struct PCB *pcb = getLivePCBs(); pcb != NULL; pcb = pcb->liveNext) {
+        if (!hasFrameQuota(pcb)) {
+            continue;
+        }
+        if (frameQuotaMode == QUOTA_PROPORTIONAL) {
+            pcb->frameQuota = (int)(frameCount * (long)pcb->pages_max / (totalPages > 0 ? totalPages : 1));
+        } else {
+            pcb->frameQuota = frameCount / processes;
+            if (remainder > 0) {
+                pcb->frameQuota++;
+                remainder--;
+            }
         }
+        if (pcb->frameQuota < 1) {
+            pcb->frameQuota = 1;
+        }
+        totalFrameQuota += pcb->frameQuota;
     }
 }
 
-// Get the value of a variable
-char *mem_get_value(char *var_in) {
-    int i;
+// PFF: grow the quota of a process that faults again too soon, as long as the
+// quotas of all processes still fit in the frame store, and shrink the quota of
+// one that went a long time without faulting
+static void adjustFaultQuota(struct PCB *pcb) {
+    int interval = pcb->virtualTime - pcb->lastFaultTime;
+    pcb->lastFaultTime = pcb->virtualTime;
 
-    for (i = 0; i < VARIABLE_STORE_SIZE; i++) {
-        if (variableStore[i].var != NULL && strcmp(variableStore[i].var, var_in) == 0) {
-            return strdup(variableStore[i].value);
+    if (interval < frameSize) {
+        if (totalFrameQuota < frameCount) {
+            pcb->frameQuota++;
+            totalFrameQuota++;
         }
+    } else if (interval > PFF_SHRINK_PAGES * frameSize && pcb->frameQuota > 1) {
+        pcb->frameQuota--;
+        totalFrameQuota--;
     }
-    return NULL;
 }
 
-// Find a free frame
-int findFreeFrame() {
-    for (int i = 0; i < FRAME_COUNT; i++) {
-        if (frameUsage[i] == -1) {
-            return i;  // Return the number of the free frame
+// Select the frame quota mode by name. Returns 0 on success, -1 if unknown.
+int setFrameQuotaMode(const char *name) {
+    for (int i = 0; i < (int)(sizeof(quotaModeNames) / sizeof(quotaModeNames[0])); i++) {
+        if (strcmp(quotaModeNames[i], name) == 0) {
+            lockPaging();
+            frameQuotaMode = i;
+            updateFrameQuotas();
+            unlockPaging();
+            return 0;
         }
     }
-    return -1;  // No free frames
+    return -1;
 }
 
-// Load a page into a frame
-void loadPageIntoFrame(int scriptStart, int pageNumber, int frameNumber) {
-    int lineNumber = scriptStart + pageNumber * FRAME_SIZE;
-    int frameStartIndex = frameNumber * FRAME_SIZE;
-    for (int i = 0; i < FRAME_SIZE; i++) {
-        int frameIndex = frameStartIndex + i;
-        if (lineNumber + i < memoryIndex && scriptMemory[lineNumber + i] != NULL) {
-            frameStore[frameIndex] = strdup(scriptMemory[lineNumber + i]);
-        } else {
-            frameStore[frameIndex] = NULL; // Empty line
+// Print the quota mode and the resident pages and quota of every process
+void printFrameQuotas() {
+    printf("Frame quota: %s; Local replacements: %d\n", quotaModeNames[frameQuotaMode], localReplacementCount);
+    if (frameQuotaMode == QUOTA_NONE) {
+        return;
+    }
+    for (struct PCB *pcb = getLivePCBs(); pcb != NULL; pcb = pcb->liveNext) {
+        if (hasFrameQuota(pcb)) {
+            printf("Process %d: %d resident, quota %d\n", pcb->pid, pcb->pages_loaded, pcb->frameQuota);
         }
     }
-    // Do not update frameUsage and currentTime here
 }
 
-// Update the page tables of all PCBs
-void updatePageTables(int evictedFrameNumber) {
-    // Traverse all PCBs and update their page tables
-    struct PCB *pcb = pcbListHead;
-    while (pcb != NULL) {
-        for (int i = 0; i < pcb->pages_max; i++) {
-            if (pcb->pageTable[i] == evictedFrameNumber) {
-                pcb->pageTable[i] = -1;  // Mark page as not loaded
-            }
-        }
-        pcb = pcb->next;
+// Handle a page fault
+void handlePageFault(struct PCB *pcb, int pageNumber) {
+    waitForScriptLines(pcb, (pageNumber + 1) * frameSize);  // The whole page must be indexed
+    lockPaging();
+    if (pcb->pageTable[pageNumber] != -1) {
+        unlockPaging();
+        return;  // Another worker's page-in already brought the content in
     }
-}
+    pageFaultCount++;
+    if (frameQuotaMode == QUOTA_PFF) {
+        adjustFaultQuota(pcb);
+    }
+
+    // Load the missing page into the selected frame
+    installPage(pcb, pageNumber, 1);
 
-// Evict the least recently used frame
-int evictLRUFrame() {
-    int lruFrame = -1;
-    int minTime = currentTime + 1;  // Initialize to a large value
+    // Read ahead when this fault continues the PCB's sequential progress. The
+    // window never reaches a quarter of the frame store, so read-ahead cannot
+    // push out the whole working set of the other processes.
+    if (pageNumber <= pcb->lastFaultPage) {
+        // Faulting again on a page already brought in: memory is tight, back off
+        pcb->prefetchWindow /= 2;
+    } else if (pageNumber <= pcb->lastFaultPage + pcb->prefetchWindow + 1) {
+        // Sequential progress; probe again if earlier waste closed the window
+        if (pcb->prefetchWindow == 0) {
+            pcb->prefetchWindow = 1;
+        }
+    } else {
+        pcb->prefetchWindow = 1;  // Jumped ahead, restart from a single page
+    }
+    pcb->lastFaultPage = pageNumber;
 
-    // Find the least recently used frame
-    for (int i = 0; i < FRAME_COUNT; i++) {
-        if (frameUsage[i] == -1) {
-            continue;  // Skip unused frames
+    int window = pcb->prefetchWindow;
+    if (window > prefetchLimit) window = prefetchLimit;
+    if (window > frameCount / 4) window = frameCount / 4;
+    if (frameQuotaMode != QUOTA_NONE && window > pcb->frameQuota - pcb->pages_loaded) {
+        window = pcb->frameQuota - pcb->pages_loaded;  // Read-ahead never replaces the process's own pages
+    }
+    for (int page = pageNumber + 1; page <= pageNumber + window && page < pcb->pages_max; page++) {
+        if (!pcb->lengthFinal && (page + 1) * frameSize > pcb->length) {
+            break;  // Still being streamed in
+        }
+        if (pcb->pageTable[page] != -1) {
+            continue;  // Already resident
         }
-        if (frameUsage[i] < minTime) {
-            minTime = frameUsage[i];
-            lruFrame = i;
+        int frameNumber = installPage(pcb, page, 0);
+        if (frameRefCount[frameNumber] == 1) {
+            __atomic_store_n(&framePrefetched[frameNumber], 1, __ATOMIC_RELAXED);  // Newly read, not just shared
+            prefetchedPageCount++;
         }
+        pcb->lastFaultPage = page;
     }
 
-    if (lruFrame == -1) {
-        // No frame to evict; handle error
-        printf("Error: No frames to evict.\n");
-        exit(1);
+    // Read-ahead must not have pushed out the page that faulted
+    if (pcb->pageTable[pageNumber] == -1) {
+        installPage(pcb, pageNumber, 0);
     }
+    unlockPaging();
+}
 
-    // Print the message indicating eviction
-    printf("Page fault! Victim page contents:\n\n");
+// Set the largest read-ahead window in pages; 0 disables read-ahead
+void setPrefetchLimit(int pages) {
+    prefetchLimit = pages;
+}
 
-    // Print and free the victim page contents
-    int frameStartIndex = lruFrame * FRAME_SIZE;
-    for (int i = 0; i < FRAME_SIZE; i++) {
-        int frameIndex = frameStartIndex + i;
-        if (frameStore[frameIndex]) {
-            printf("%s", frameStore[frameIndex]);
-            free(frameStore[frameIndex]);
-            frameStore[frameIndex] = NULL;
-        }
+
+// Validate and set the memory sizes used by mem_init. Returns 0 on success, -1
+// if a size is invalid or the frame store would hold no frame.
+int setMemorySizes(int frameStoreLines, int frameLines, int variables) {
+    if (frameLines < 1 || frameStoreLines / frameLines < 1 || variables < 1) {
+        return -1;
     }
+    frameStoreSize = frameStoreLines;
+    frameSize = frameLines;
+    frameCount = frameStoreLines / frameLines;
+    variableStoreSize = variables;
+    return 0;
+}
 
-    printf("\nEnd of victim page contents.\n");
+// Drop a resident page without printing it, invalidating every page table
+// entry that maps it
+static void discardFrame(int frameNumber) {
+    unindexFrameContent(frameNumber);
+    updatePageTables(frameNumber);
+    frameInUse[frameNumber] = 0;
+    frameKey[frameNumber] = -1;
+    framePrefetched[frameNumber] = 0;
+}
 
-    frameUsage[lruFrame] = -1; // Mark the frame as unused
+// Move the page held in one frame to a free frame, re-pointing every page
+// table entry that maps it
+static void moveFrame(int from, int to) {
+    memcpy(frameLine(to, 0), frameLine(from, 0), frameStride);
+    frameInUse[to] = 1;
+    frameKey[to] = frameKey[from];
+    frameOwner[to] = frameOwner[from];
+    frameOwnerPage[to] = frameOwnerPage[from];
+    frameRefCount[to] = frameRefCount[from];
+    framePrefetched[to] = framePrefetched[from];
 
-    // Update all PCBs' page tables
-    updatePageTables(lruFrame);
+    struct PCB *pcb = frameOwner[to];
+    int pageNumber = frameOwnerPage[to];
+    while (pcb != NULL) {
+        pcb->pageTable[pageNumber] = to;
+        struct PageSharer next = pcb->pageSharers[pageNumber];
+        pcb = next.pcb;
+        pageNumber = next.page;
+    }
 
-    return lruFrame;
+    frameInUse[from] = 0;
+    frameKey[from] = -1;
+    frameOwner[from] = NULL;
+    frameOwnerPage[from] = -1;
+    frameRefCount[from] = 0;
+    framePrefetched[from] = 0;
 }
 
+// Rebuild the free list, the content index and the replacement policy state
+// from the resident frames
+static void rebuildFrameIndexes() {
+    freeFrameCount = 0;
+    for (int i = frameCount - 1; i >= 0; i--) {
+        if (!frameInUse[i]) {
+            freeFrames[freeFrameCount++] = i;
+        }
+    }
+    for (int i = 0; i < 2 * frameCount; i++) {
+        contentBuckets[i] = -1;
+    }
+    for (int i = 0; i < frameCount; i++) {
+        frameHashNext[i] = -1;
+        if (frameInUse[i]) {
+            indexFrameContent(i);
+        }
+    }
+    setReplacementPolicy(replacementPolicy->name);
+}
 
-// Handle a page fault
-void handlePageFault(struct PCB *pcb, int pageNumber) {
-    int frameNumber = findFreeFrame();
-    if (frameNumber == -1) {
-        // No free frame, eviction is needed
-        frameNumber = evictLRUFrame();
-        // In evictLRUFrame(), the "Page fault! Victim page contents:" message is printed
-    } else {
-        // Free frame is available
-        printf("Page fault!\n");
+// Grow or shrink the frame store to the given number of lines while programs
+// keep running. Resident pages are kept: pages in frames that disappear move to
+// free frames below the new limit, and only when none is left are they dropped
+// to be faulted back in later. Returns 0 on success, -1 if the size is invalid.
+int resizeFrameStore(int lines) {
+    int newCount = lines / frameSize;
+    if (newCount < 1) {
+        return -1;
     }
+    while (finishPageIns(1) > 0);  // Frames must not move while being filled
+    waitForScriptLoader();
+    clearFrameAccessLogs();  // They may name frames that are about to go
 
-    // Load the missing page into the selected frame
-    loadPageIntoFrame(pcb->start, pageNumber, frameNumber);
+    // Compact resident pages into the frames that remain
+    int low = 0;
+    for (int f = newCount; f < frameCount; f++) {
+        if (!frameInUse[f]) {
+            continue;
+        }
+        while (low < newCount && frameInUse[low]) {
+            low++;
+        }
+        if (low < newCount) {
+            moveFrame(f, low);
+        } else {
+            discardFrame(f);
+        }
+    }
 
-    // Update the page table
-    pcb->pageTable[pageNumber] = frameNumber;
-    pcb->pages_loaded++;
+    // Resize the slab; posix_memalign keeps frames cache line aligned
+    char *newStore;
+    if (posix_memalign((void **)&newStore, CACHE_LINE_SIZE, frameStride * newCount) != 0) {
+        return -1;
+    }
+    int kept = newCount < frameCount ? newCount : frameCount;
+    memset(newStore, 0, frameStride * newCount);
+    memcpy(newStore, frameStore, frameStride * kept);
+    free(frameStore);
+    frameStore = newStore;
+
+    frameInUse = (int *)realloc(frameInUse, sizeof(int) * newCount);
+    frameKey = (long *)realloc(frameKey, sizeof(long) * newCount);
+    freeFrames = (int *)realloc(freeFrames, sizeof(int) * newCount);
+    frameOwner = (struct PCB **)realloc(frameOwner, sizeof(struct PCB *) * newCount);
+    frameOwnerPage = (int *)realloc(frameOwnerPage, sizeof(int) * newCount);
+    frameRefCount = (int *)realloc(frameRefCount, sizeof(int) * newCount);
+    contentBuckets = (int *)realloc(contentBuckets, sizeof(int) * 2 * newCount);
+    frameHashNext = (int *)realloc(frameHashNext, sizeof(int) * newCount);
+    framePrefetched = (int *)realloc(framePrefetched, sizeof(int) * newCount);
+    framePrev = (int *)realloc(framePrev, sizeof(int) * newCount);
+    frameNext = (int *)realloc(frameNext, sizeof(int) * newCount);
+    frameList = (int *)realloc(frameList, sizeof(int) * newCount);
+    frameReferenced = (int *)realloc(frameReferenced, sizeof(int) * newCount);
+    frameLoading = (int *)realloc(frameLoading, sizeof(int) * newCount);
+    framePins = (int *)realloc(framePins, sizeof(int) * newCount);
+    frameAccessStamp = (long *)realloc(frameAccessStamp, sizeof(long) * newCount);
+    frameAppliedStamp = (long *)realloc(frameAppliedStamp, sizeof(long) * newCount);
+    accessBatch = (struct FrameAccess *)realloc(accessBatch, sizeof(struct FrameAccess) * newCount);
+    frameLogged = (int *)realloc(frameLogged, sizeof(int) * newCount);
+    for (int i = 0; i <= MAX_WORKERS; i++) {
+        accessLogs[i].frames = (int *)realloc(accessLogs[i].frames, sizeof(int) * newCount);
+    }
+    ghosts = (struct GhostEntry *)realloc(ghosts, sizeof(struct GhostEntry) * (newCount + 1));
+    ghostBuckets = (int *)realloc(ghostBuckets, sizeof(int) * 2 * (newCount + 1));
 
-    // Update the frame usage time
-    accessFrame(frameNumber);
+    for (int f = frameCount; f < newCount; f++) {
+        frameInUse[f] = 0;
+        frameKey[f] = -1;
+        frameOwner[f] = NULL;
+        frameOwnerPage[f] = -1;
+        frameRefCount[f] = 0;
+        framePrefetched[f] = 0;
+        frameLoading[f] = 0;
+        framePins[f] = 0;
+        frameAccessStamp[f] = 0;
+        frameAppliedStamp[f] = 0;
+        frameLogged[f] = 0;
+    }
+    frameCount = newCount;
+    frameStoreSize = lines;
+    lastAccessedFrame = -1;
+    rebuildFrameIndexes();
+    updateFrameQuotas();
+    return 0;
 }
 
+// Change the number of lines per page and frame. Every page of every live
+// program is unmapped and its page table rebuilt for the new page size; pages
+// fault back in as the programs continue. Returns 0 on success, -1 if invalid.
+int resizeFrameSize(int lines) {
+    if (lines < 1 || frameStoreSize / lines < 1) {
+        return -1;
+    }
+    while (finishPageIns(1) > 0);  // Frames must not move while being filled
+    waitForScriptLoader();
+
+    for (int f = 0; f < frameCount; f++) {
+        if (frameInUse[f]) {
+            discardFrame(f);
+        }
+    }
+
+    for (struct PCB *pcb = getLivePCBs(); pcb != NULL; pcb = pcb->liveNext) {
+        if (pcb->pageSharers == NULL) {
+            continue;  // Not loaded yet; loadScript sizes its page table
+        }
+        waitForScriptLines(pcb, pcb->length + 1);  // Page tables are sized from the final length
+        pcb->pages_max = (pcb->length + lines - 1) / lines;
+        freePageTables(pcb);
+        allocPageTables(pcb, pcb->pages_max);
+        pcb->pages_loaded = 0;
+        pcb->privateFrames = 0;
+        pcb->lastFaultPage = -1;
+        pcb->prefetchWindow = 1;
+    }
+
+    swapCacheClear();  // Cached pages start at lines of the old page size
+    freeFrameTables();
+    frameSize = lines;
+    frameCount = frameStoreSize / frameSize;
+    allocateFrameTables();
+    updateFrameQuotas();
+    return 0;
+}
 
 // Get a line of script from the PCB's page table
 char *getLineFromPCB(struct PCB *pcb) {
@@ -224,93 +2576,616 @@ char *getLineFromPCB(struct PCB *pcb) {
         return NULL;  // Program has ended
     }
 
-    int pageNumber = pcb->pc / FRAME_SIZE;
-    int offset = pcb->pc % FRAME_SIZE;
+    int pageNumber = pcb->pc / frameSize;
+    int offset = pcb->pc % frameSize;
 
-    int frameNumber = pcb->pageTable[pageNumber];
+    // A frame pinned by an MT worker holds the page until it is unpinned, even
+    // if an evicting worker has already cleared the page table entry
+    int frameNumber = pcb->pinnedFrame != -1 ? pcb->pinnedFrame : pcb->pageTable[pageNumber];
     if (frameNumber == -1) {
         // Page not loaded
         return NULL;
     }
 
-    int frameIndex = frameNumber * FRAME_SIZE + offset;
-    return frameStore[frameIndex];
+    // First use of a prefetched page: the read-ahead paid off, widen the window
+    if (__atomic_exchange_n(&framePrefetched[frameNumber], 0, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&prefetchHitCount, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pcb->prefetchWindow, 1, __ATOMIC_RELAXED);
+    }
+
+    // Record the reference for the working set estimate
+    pcb->virtualTime++;
+    pcb->pageLastUse[pageNumber] = pcb->virtualTime;
+
+    return frameLine(frameNumber, offset);
 }
 
+// Whether a page of a PCB takes no frame of its own: it is mapped to a frame
+// other processes map too, or not mapped yet while a frame holds its content,
+// so faulting it in only maps that frame
+static int pageShared(struct PCB *pcb, int pageNumber) {
+    int frameNumber = pcb->pageTable[pageNumber];
+    if (frameNumber != -1) {
+        return frameRefCount[frameNumber] > 1;
+    }
+    int scriptEnd = pcb->start + pcb->length;
+    return findSharedFrame(pageContentHash(pcb->start, scriptEnd, pageNumber), pcb->start, scriptEnd, pageNumber) != -1;
+}
 
+// The working set of a process: the pages it referenced within its last
+// WORKING_SET_WINDOW pages' worth of instructions, plus the page it runs next.
+// Scripts execute sequentially, so the pages referenced in the window lie just
+// below the current one and the scan stops at the first stale page. A page
+// whose content is resident in a frame other processes use is not counted: the
+// frame is taken whether or not this process runs, and counting it for every
+// sharer would suspend processes that fit. Returns the frames the process
+// needs for itself, apart from the page it runs next when no frame holds that
+// page yet: that page's first line is returned in missingLine, or -1.
+static int ownWorkingSet(struct PCB *pcb, int *missingLine) {
+    *missingLine = -1;
+    if (pcb->pc >= pcb->length || pcb->pageLastUse == NULL) {
+        return 0;
+    }
 
-// Load a script into memory (supports paging)
-int loadScript(const char *filename, struct PCB *pcb) {
-    // Check if the script exists
-    char backingStorePath[256];
-    snprintf(backingStorePath, sizeof(backingStorePath), "backing_store/%s", filename);
+    int window = WORKING_SET_WINDOW * frameSize;
+    int currentPage = pcb->pc / frameSize;
+    int pages = 0;
+    if (pcb->pageTable[currentPage] == -1 && !pageShared(pcb, currentPage)) {
+        *missingLine = pcb->start + currentPage * frameSize;
+    } else {
+        pages += !pageShared(pcb, currentPage);
+    }
+    for (int page = currentPage - 1; page >= 0; page--) {
+        if (pcb->pageLastUse[page] == 0 || pcb->virtualTime - pcb->pageLastUse[page] >= window) {
+            break;
+        }
+        pages += !pageShared(pcb, page);
+    }
+    return pages;
+}
 
-    FILE *sourceFile = fopen(filename, "r");
-    if (!sourceFile) {
-        printf("Error: Cannot open script file %s\n", filename);
-        return -1;
+// Frames a process would add to the working set of the ready processes. A
+// missing page that ready processes running the same lines are already about
+// to fault in is counted once, for the first of them.
+int estimateWorkingSet(struct PCB *pcb) {
+    int missingLine;
+    int pages = ownWorkingSet(pcb, &missingLine);
+    return missingLine != -1 && scriptLine(missingLine)->demand == 0 ? pages + 1 : pages;
+}
+
+// Count a process's working set as it joins the ready processes; returns the
+// frames it adds. releaseWorkingSet takes the same frames back when it leaves.
+int claimWorkingSet(struct PCB *pcb) {
+    int pages = ownWorkingSet(pcb, &pcb->workingSetLine);
+    pcb->workingSet = pages;
+    if (pcb->workingSetLine != -1 && scriptLine(pcb->workingSetLine)->demand++ == 0) {
+        pages++;
+    }
+    return pages;
+}
+
+int releaseWorkingSet(struct PCB *pcb) {
+    int pages = pcb->workingSet;
+    if (pcb->workingSetLine != -1 && --scriptLine(pcb->workingSetLine)->demand == 0) {
+        pages++;
     }
+    pcb->workingSet = 0;
+    pcb->workingSetLine = -1;
+    return pages;
+}
 
-    FILE *destFile = fopen(backingStorePath, "w");
-    if (!destFile) {
+
+
+// Wait until the streaming loader has indexed the first lines lines of the
+// PCB's script, or finished it, and bring the PCB's length up to date. Called
+// by the thread running the PCB; the loader only publishes linesLoaded.
+static void waitForScriptLines(struct PCB *pcb, int lines) {
+    if (pcb->lengthFinal || pcb->length >= lines) {
+        return;
+    }
+    pthread_mutex_lock(&scriptLoadMutex);
+    while (pcb->loading && pcb->linesLoaded < lines) {
+        pthread_cond_wait(&scriptLinesLoaded, &scriptLoadMutex);
+    }
+    int loaded = pcb->linesLoaded;
+    int done = !pcb->loading;
+    pthread_mutex_unlock(&scriptLoadMutex);
+
+    lockPaging();
+    pcb->length = loaded;
+    if (done) {
+        pcb->lengthFinal = 1;
+        pcb->pages_max = (loaded + frameSize - 1) / frameSize;
+    }
+    unlockPaging();
+}
+
+// Wait until the line at the PCB's pc has been loaded. Returns 1 if there is a
+// line to run, 0 once the script has ended.
+int waitForLine(struct PCB *pcb) {
+    waitForScriptLines(pcb, pcb->pc + 1);
+    return pcb->pc < pcb->length;
+}
+
+// Wait until the whole script of the PCB has been loaded, so its length is final
+void waitForScript(struct PCB *pcb) {
+    waitForScriptLines(pcb, INT_MAX);
+}
+
+// Wait until every queued streaming load has finished
+void waitForScriptLoader() {
+    pthread_mutex_lock(&scriptLoadMutex);
+    while (scriptLoadsPending > 0) {
+        pthread_cond_wait(&scriptLinesLoaded, &scriptLoadMutex);
+    }
+    pthread_mutex_unlock(&scriptLoadMutex);
+}
+
+// Make the first count lines of a streaming load visible to the PCB
+static void publishScriptLines(struct PCB *pcb, int count) {
+    pthread_mutex_lock(&scriptLoadMutex);
+    pcb->linesLoaded = count;
+    pthread_cond_broadcast(&scriptLinesLoaded);
+    pthread_mutex_unlock(&scriptLoadMutex);
+}
+
+// Copy a script into its backing store mapping a chunk at a time, indexing the
+// lines each chunk completes and publishing them before the next read. A line
+// is complete at its newline, at MAX_LINE_LENGTH - 1 bytes, or at the end of
+// the file, the same split mapScriptLines makes. Lines beyond the count taken
+// when the load was queued, from a file that grew since, are left out.
+static void streamScriptLines(struct ScriptLoad *load) {
+    struct PCB *pcb = load->pcb;
+    int start = load->start;
+    int capacity = load->lineCount;
+
+    size_t size = load->size;
+    size_t filled = 0;
+    size_t offset = 0;
+    int count = 0;
+    int full = 0;
+    while (offset < size && !full) {
+        if (filled < size) {
+            size_t want = size - filled < STREAM_CHUNK_BYTES ? size - filled : STREAM_CHUNK_BYTES;
+            ssize_t bytes = read(load->sourceFd, load->base + filled, want);
+            if (bytes <= 0) {
+                size = filled;  // The file shrank or cannot be read; end at what arrived
+            } else {
+                filled += (size_t)bytes;
+            }
+        }
+
+        while (offset < filled) {
+            size_t length = nextLineLength(load->base + offset, filled - offset);
+            if (offset + length == filled && filled < size
+                && length < MAX_LINE_LENGTH - 1 && load->base[filled - 1] != '\n') {
+                break;  // The rest of the line is in the next chunk
+            }
+            if (count == capacity) {
+                full = 1;
+                break;
+            }
+            scriptLine(start + count)->text = load->base + offset;
+            scriptLine(start + count)->length = (int)length;
+            count++;
+            offset += length;
+        }
+        publishScriptLines(pcb, count);
+    }
+
+    // Hand back the part of the range a file that shrank did not need
+    pthread_mutex_lock(&scriptMemoryMutex);
+    if (count == 0) {
+        scriptLine(start)->arena = NULL;
+        scriptLine(start)->mappingSize = 0;
+        scriptLine(start)->users = 0;
+    }
+    if (capacity > count) {
+        freeScriptRange(start + count, capacity - count);
+    }
+    pthread_mutex_unlock(&scriptMemoryMutex);
+    if (count == 0) {
+        munmap(load->base, load->size);
+    } else {
+        madvise(load->base, load->size, MADV_DONTNEED);  // Pages fault lines in from the file
+    }
+    close(load->sourceFd);
+}
+
+// Loader thread: stream queued scripts in submission order
+static void *scriptLoader(void *arg) {
+    for (;;) {
+        pthread_mutex_lock(&scriptLoadMutex);
+        while (scriptLoadHead == NULL) {
+            pthread_cond_wait(&scriptLoadQueued, &scriptLoadMutex);
+        }
+        struct ScriptLoad *load = scriptLoadHead;
+        scriptLoadHead = load->next;
+        if (scriptLoadHead == NULL) {
+            scriptLoadTail = NULL;
+        }
+        pthread_mutex_unlock(&scriptLoadMutex);
+
+        streamScriptLines(load);
+
+        pthread_mutex_lock(&scriptLoadMutex);
+        load->pcb->loading = 0;
+        scriptLoadsPending--;
+        pthread_cond_broadcast(&scriptLinesLoaded);
+        pthread_mutex_unlock(&scriptLoadMutex);
+        free(load);
+    }
+    return NULL;
+}
+
+static int scriptLoaderBusy() {
+    pthread_mutex_lock(&scriptLoadMutex);
+    int busy = scriptLoadsPending > 0;
+    pthread_mutex_unlock(&scriptLoadMutex);
+    return busy;
+}
+
+// Hand a script to the streaming loader. The backing store file is created at
+// its final size and mapped so the loader copies straight into the mapping;
+// an older backing store file of the same name is unlinked rather than
+// truncated, since processes still running it have it mapped. Script memory
+// for lineCount lines is reserved first; returns -2 if it is full.
+static int startScriptLoad(FILE *sourceFile, const char *backingStorePath, size_t size, int lineCount,
+                           struct PCB *pcb) {
+    pthread_mutex_lock(&scriptMemoryMutex);
+    int start = reserveScriptLines(lineCount);
+    pthread_mutex_unlock(&scriptMemoryMutex);
+    if (start == -1) {
+        fclose(sourceFile);
+        return -2;
+    }
+
+    unlink(backingStorePath);
+    int fd = open(backingStorePath, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1 || ftruncate(fd, (off_t)size) == -1) {
         printf("Error: Cannot create backing store file %s\n", backingStorePath);
+        if (fd != -1) {
+            close(fd);
+        }
+        fclose(sourceFile);
+        pthread_mutex_lock(&scriptMemoryMutex);
+        freeScriptRange(start, lineCount);
+        pthread_mutex_unlock(&scriptMemoryMutex);
+        return -1;
+    }
+    char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("Error: Cannot map backing store file %s\n", backingStorePath);
         fclose(sourceFile);
+        pthread_mutex_lock(&scriptMemoryMutex);
+        freeScriptRange(start, lineCount);
+        pthread_mutex_unlock(&scriptMemoryMutex);
         return -1;
     }
+    pthread_mutex_lock(&scriptMemoryMutex);
+    scriptLine(start)->arena = base;
+    scriptLine(start)->mappingSize = size;
+    scriptLine(start)->users = 1;
+    pthread_mutex_unlock(&scriptMemoryMutex);
+
+    struct ScriptLoad *load = (struct ScriptLoad *)malloc(sizeof(struct ScriptLoad));
+    load->pcb = pcb;
+    load->sourceFd = dup(fileno(sourceFile));
+    load->base = base;
+    load->size = size;
+    load->start = start;
+    load->lineCount = lineCount;
+    load->next = NULL;
+    fclose(sourceFile);
+
+    pcb->start = start;
+    pcb->length = 0;
+    pcb->lengthFinal = 0;
+    pcb->loading = 1;
+    pcb->linesLoaded = 0;
+    pcb->pages_max = (lineCount + frameSize - 1) / frameSize;
+    pcb->pages_loaded = 0;
+    pcb->privateFrames = 0;
+    lockPaging();
+    allocPageTables(pcb, pcb->pages_max);
+    updateFrameQuotas();
+    unlockPaging();
+
+    pthread_mutex_lock(&scriptLoadMutex);
+    if (!scriptLoaderStarted) {
+        pthread_t loader;
+        pthread_create(&loader, NULL, scriptLoader, NULL);
+        pthread_detach(loader);
+        scriptLoaderStarted = 1;
+    }
+    if (scriptLoadTail != NULL) {
+        scriptLoadTail->next = load;
+    } else {
+        scriptLoadHead = load;
+    }
+    scriptLoadTail = load;
+    scriptLoadsPending++;
+    pthread_cond_signal(&scriptLoadQueued);
+    pthread_mutex_unlock(&scriptLoadMutex);
+    return 0;
+}
+
+#define LOAD_THREADS 4  // Workers copying and indexing scripts for one exec
+
+// A script between the parallel copy-and-index step and the ordered page install
+struct ScriptPrep {
+    const char *filename;
+    struct PCB *pcb;
+    FILE *sourceFile;    // Kept open for the streaming loader
+    size_t size;
+    int stream;          // Left to the streaming loader
+    int start;           // Indexed line range
+    int lineCount;
+    int error;           // One of the PREP_ codes
+    struct ScriptPrep *primary;  // Earlier load of the same script in the batch
+    int shared;          // Runs the lines the primary indexed
+};
+
+enum { PREP_OK, PREP_NO_SOURCE, PREP_NO_BACKING_STORE, PREP_NO_MAPPING, PREP_MEMORY_FULL };
+
+static int backingStoreSerial = 0;
+
+// Copy a script to its backing store file and index its lines, or mark it for
+// the streaming loader. Touches no paging state, so scripts can be prepared on
+// several threads at once. The copy is written under a temporary name and
+// renamed into place, and the index is built from the file this call wrote,
+// so two loads of the same script never read each other's half-written copy.
+static void prepareScript(struct ScriptPrep *prep) {
+    char backingStorePath[256];
+    snprintf(backingStorePath, sizeof(backingStorePath), "backing_store/%s", prep->filename);
+
+    prep->sourceFile = fopen(prep->filename, "r");
+    if (!prep->sourceFile) {
+        prep->error = PREP_NO_SOURCE;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fileno(prep->sourceFile), &st) == 0 && st.st_size > 0
+        && (st.st_size >= STREAM_MIN_BYTES || scriptLoaderBusy())) {
+        prep->stream = 1;
+        prep->size = (size_t)st.st_size;
+        prep->lineCount = countScriptLines(fileno(prep->sourceFile), prep->size);
+        return;
+    }
+
+    char tempPath[300];
+    snprintf(tempPath, sizeof(tempPath), "%s.%d", backingStorePath,
+             __atomic_fetch_add(&backingStoreSerial, 1, __ATOMIC_RELAXED));
+    FILE *destFile = fopen(tempPath, "w+");
+    if (!destFile) {
+        fclose(prep->sourceFile);
+        prep->error = PREP_NO_BACKING_STORE;
+        return;
+    }
 
     // Copy the script to the backing store
-    char line[MAX_LINE_LENGTH];
-    while (fgets(line, sizeof(line), sourceFile)) {
-        fputs(line, destFile);
+    char buffer[4096];
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), prep->sourceFile)) > 0) {
+        fwrite(buffer, 1, bytes, destFile);
     }
-    fclose(sourceFile);
+    fclose(prep->sourceFile);
+    fflush(destFile);
+    rename(tempPath, backingStorePath);
+
+    // Page the script from the backing store through a line index
+    prep->start = mapScriptLines(fileno(destFile), &prep->lineCount);
     fclose(destFile);
+    if (prep->start == -1) {
+        prep->error = PREP_NO_MAPPING;
+    } else if (prep->start == -2) {
+        prep->error = PREP_MEMORY_FULL;
+    }
+}
 
-    // Load the script into script memory
-    FILE *file = fopen(backingStorePath, "r");
-    if (!file) {
-        printf("Error: Cannot open backing store file %s\n", backingStorePath);
-        return -1;
+// Give up on a prepared script that will not be installed
+static void discardScript(struct ScriptPrep *prep) {
+    if (prep->error != PREP_OK || prep->shared) {
+        return;
+    }
+    if (prep->stream) {
+        fclose(prep->sourceFile);
+    } else {
+        releaseScriptLines(prep->start, prep->lineCount);
     }
+}
+
+// Report a failed preparation, start a streaming load, or set up the PCB's
+// page tables and install its first pages. Runs in exec order.
+static int finishScript(struct ScriptPrep *prep) {
+    char backingStorePath[256];
+    snprintf(backingStorePath, sizeof(backingStorePath), "backing_store/%s", prep->filename);
+    struct PCB *pcb = prep->pcb;
 
-    int startIndex = memoryIndex; // Start index of the script in scriptMemory
-    int lineCount = 0;
-    while (fgets(line, sizeof(line), file)) {
-        if (memoryIndex >= MAX_SCRIPTS) {
+    switch (prep->error) {
+    case PREP_NO_SOURCE:
+        printf("Error: Cannot open script file %s\n", prep->filename);
+        return -1;
+    case PREP_NO_BACKING_STORE:
+        printf("Error: Cannot create backing store file %s\n", backingStorePath);
+        return -1;
+    case PREP_NO_MAPPING:
+        printf("Error: Cannot map backing store file %s\n", backingStorePath);
+        return -1;
+    case PREP_MEMORY_FULL:
+        printf("Error: Script memory is full\n");
+        return -1;
+    }
+    if (prep->stream) {
+        int result = startScriptLoad(prep->sourceFile, backingStorePath, prep->size, prep->lineCount, pcb);
+        if (result == -2) {
             printf("Error: Script memory is full\n");
-            fclose(file);
             return -1;
         }
-        scriptMemory[memoryIndex] = strdup(line); // Store in logical memory
-        memoryIndex++;
-        lineCount++;
+        return result;
+    }
+
+    if (prep->shared) {
+        // Run the lines an earlier load of the same script indexed
+        prep->start = prep->primary->start;
+        prep->lineCount = prep->primary->lineCount;
+        if (prep->lineCount > 0) {
+            pthread_mutex_lock(&scriptMemoryMutex);
+            scriptLine(prep->start)->users++;
+            pthread_mutex_unlock(&scriptMemoryMutex);
+        }
     }
-    fclose(file);
 
-    pcb->start = startIndex;
-    pcb->length = lineCount;
+    lockPaging();
+    pcb->start = prep->start;
+    pcb->length = prep->lineCount;
 
     // Calculate the number of pages required
-    pcb->pages_max = (lineCount + FRAME_SIZE - 1) / FRAME_SIZE;
+    pcb->pages_max = (prep->lineCount + frameSize - 1) / frameSize;
     pcb->pages_loaded = 0;
+    pcb->privateFrames = 0;
 
-    pcb->pageTable = (int *)malloc(sizeof(int) * pcb->pages_max);
-    for (int i = 0; i < pcb->pages_max; i++) {
-        pcb->pageTable[i] = -1; // Mark all pages as not loaded
-    }
+    allocPageTables(pcb, pcb->pages_max);  // All pages start out not loaded
 
-    // Load the first two pages (if applicable)
+    // Load the first two pages (if applicable), within the process's quota
+    updateFrameQuotas();
     int pagesToLoad = pcb->pages_max > 2 ? 2 : pcb->pages_max;
+    if (frameQuotaMode != QUOTA_NONE && pagesToLoad > pcb->frameQuota) {
+        pagesToLoad = pcb->frameQuota;
+    }
     for (int pageNum = 0; pageNum < pagesToLoad; pageNum++) {
-        int frameNumber = findFreeFrame();
-        if (frameNumber == -1) {
-            frameNumber = evictLRUFrame();
+        installPage(pcb, pageNum, 0);
+    }
+
+    // Map the remaining pages whose content is already resident, e.g. because
+    // the same script is running or ran recently, so they never fault
+    int scriptEnd = pcb->start + pcb->length;
+    for (int pageNum = pagesToLoad; pageNum < pcb->pages_max; pageNum++) {
+        long key = pageContentHash(pcb->start, scriptEnd, pageNum);
+        int frameNumber = findSharedFrame(key, pcb->start, scriptEnd, pageNum);
+        if (frameNumber != -1) {
+            if (frameRefCount[frameNumber] > 0) {
+                sharedMappingCount++;
+            }
+            mapFrame(pcb, pageNum, frameNumber);
         }
-        loadPageIntoFrame(pcb->start, pageNum, frameNumber);
-        pcb->pageTable[pageNum] = frameNumber;
-        pcb->pages_loaded++;
-        accessFrame(frameNumber);  // Update frame usage time
     }
+    releaseMappedPages(pcb, 0, pcb->pages_max);
+    unlockPaging();
 
     return 0;
 }
+
+// Load a script into memory (supports paging). Large scripts, and any script
+// submitted while the streaming loader is busy, are streamed: the call returns
+// at once and the process waits for its lines as it reaches them.
+int loadScript(const char *filename, struct PCB *pcb) {
+    struct ScriptPrep prep = {.filename = filename, .pcb = pcb};
+    prepareScript(&prep);
+    return finishScript(&prep);
+}
+
+struct ScriptBatch {
+    struct ScriptPrep *preps;
+    int count;
+    int duplicates;  // 0 to prepare first loads of each script, 1 for repeats
+    int next;        // Next script to prepare, claimed atomically
+};
+
+// Share the line index an earlier load of the same script built, rather than
+// copying and indexing the script again. A script that failed to load or is
+// still streaming in is loaded again on its own.
+static void prepareDuplicate(struct ScriptPrep *prep) {
+    struct ScriptPrep *primary = prep->primary;
+    if (primary->error != PREP_OK || primary->stream) {
+        prepareScript(prep);
+        return;
+    }
+    prep->shared = 1;
+}
+
+static void *prepareScripts(void *arg) {
+    struct ScriptBatch *batch = (struct ScriptBatch *)arg;
+    int i;
+    while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count) {
+        struct ScriptPrep *prep = &batch->preps[i];
+        if (batch->duplicates && prep->primary != NULL) {
+            prepareDuplicate(prep);
+        } else if (!batch->duplicates && prep->primary == NULL) {
+            prepareScript(prep);
+        }
+    }
+    return NULL;
+}
+
+// Run one pass of preparation over a batch on the load threads
+static void runScriptBatch(struct ScriptBatch *batch) {
+    batch->next = 0;
+    int threadCount = batch->count < LOAD_THREADS ? batch->count : LOAD_THREADS;
+    pthread_t threads[LOAD_THREADS];
+    for (int t = 1; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, prepareScripts, batch);
+    }
+    prepareScripts(batch);
+    for (int t = 1; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+// Order loads by script name, then by position in the batch
+static int compareScriptPreps(const void *a, const void *b) {
+    const struct ScriptPrep *x = *(const struct ScriptPrep **)a;
+    const struct ScriptPrep *y = *(const struct ScriptPrep **)b;
+    int byName = strcmp(x->filename, y->filename);
+    if (byName != 0) {
+        return byName;
+    }
+    return x < y ? -1 : x > y;
+}
+
+// Point every repeated load of a script at its first load in the batch
+static void findDuplicateScripts(struct ScriptPrep *preps, int count) {
+    struct ScriptPrep **byName = (struct ScriptPrep **)malloc(sizeof(struct ScriptPrep *) * count);
+    for (int i = 0; i < count; i++) {
+        byName[i] = &preps[i];
+    }
+    qsort(byName, count, sizeof(struct ScriptPrep *), compareScriptPreps);
+    for (int i = 1; i < count; i++) {
+        if (strcmp(byName[i]->filename, byName[i - 1]->filename) == 0) {
+            byName[i]->primary = byName[i - 1]->primary != NULL ? byName[i - 1]->primary : byName[i - 1];
+        }
+    }
+    free(byName);
+}
+
+// Load several scripts for one exec: backing store copies and line indexes are
+// built by a pool of threads, then page tables and first pages are set up in
+// order, so PIDs, frames and messages come out as if loaded one by one. A
+// script named several times is copied and indexed once. Stops at the first script that
+// fails and returns its index, or -1 if all loaded.
+int loadScripts(char **filenames, struct PCB **pcbs, int count) {
+    struct ScriptPrep *preps = (struct ScriptPrep *)calloc(count, sizeof(struct ScriptPrep));
+    for (int i = 0; i < count; i++) {
+        preps[i].filename = filenames[i];
+        preps[i].pcb = pcbs[i];
+    }
+    findDuplicateScripts(preps, count);
+
+    struct ScriptBatch batch = {preps, count, 0, 0};
+    runScriptBatch(&batch);
+    batch.duplicates = 1;
+    runScriptBatch(&batch);
+
+    int failed = -1;
+    for (int i = 0; i < count; i++) {
+        if (failed != -1) {
+            discardScript(&preps[i]);
+        } else if (finishScript(&preps[i]) == -1) {
+            failed = i;
+        }
+    }
+    free(preps);
+    return failed;
+}
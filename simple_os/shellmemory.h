@@ -2,14 +2,26 @@
 #define SHELLMEMORY_H
 
 #define MEM_SIZE 1000  // Adjust as needed
-#define MAX_SCRIPTS 1000
+// Lines of script memory, shared by all loaded programs, allocated at startup;
+// SCRIPT_MEMORY_SIZE comes from the Makefile. Script memory grows past it a
+// chunk of SCRIPT_CHUNK_LINES lines at a time, up to MAX_SCRIPTS lines.
+#ifndef SCRIPT_MEMORY_SIZE
+#define SCRIPT_MEMORY_SIZE 1000
+#endif
+#define SCRIPT_CHUNK_LINES 1024
+#define MAX_SCRIPTS (SCRIPT_CHUNK_LINES * 65536)
 #define MAX_LINE_LENGTH 100
+#include <stddef.h>
 #include "pcb.h"
 
-#define FRAME_SIZE 3
+#define DEFAULT_FRAME_SIZE 3
+
+extern int frameSize;          // Lines per page and per frame
+extern int frameStoreSize;     // Lines in the frame store
+extern int frameCount;         // Frames in the frame store
+extern int variableStoreSize;  // Variables held before the variable store grows
 
 extern int memoryIndex;  // Declare memoryIndex as external
-extern char *scriptMemory[MAX_SCRIPTS];
 
 // Declare the functions and structures for shell memory and scripts
 int loadScriptIntoMemory(const char *filename);
@@ -18,12 +30,48 @@ char *getScriptLine(int index);
 // Other function declarations...
 void mem_init();
 void mem_set_value(char *var_in, char *value_in);
-char *mem_get_value(char *var_in);
+int mem_read_value(const char *var_in, char *buffer, size_t bufferSize);
 char *getLineFromPCB(struct PCB *pcb);
 int loadScript(const char *filename, struct PCB *pcb);
+int loadScripts(char **filenames, struct PCB **pcbs, int count);
+int addScriptLines(char *arena, int lineCount);
+void releaseScriptLines(int start, int lineCount);
 
 void handlePageFault(struct PCB *pcb, int pageNumber);
 void initializeFrameStore();
 void accessFrame(int frameNumber);
+int setReplacementPolicy(const char *name);
+const char *getReplacementPolicyName();
+void printPagingStats();
+void setPrefetchLimit(int pages);
+int setMemorySizes(int frameStoreLines, int frameLines, int variables);
+int resizeFrameStore(int lines);
+int resizeFrameSize(int lines);
+int resizeVariableStore(int variables);
+
+// Working set window, in pages' worth of instruction references
+#define WORKING_SET_WINDOW 2
+
+int estimateWorkingSet(struct PCB *pcb);
+int claimWorkingSet(struct PCB *pcb);
+int releaseWorkingSet(struct PCB *pcb);
+void updateFrameQuotas();
+int setFrameQuotaMode(const char *name);
+void printFrameQuotas();
+void setSwapCacheCapacity(int bytes);
+void printSwapCacheStats();
+int requestPageIn(struct PCB *pcb, int pageNumber);
+int finishPageIns(int wait);
+void setAsyncPageIn(int enabled);
+int isAsyncPageIn();
+void printPageInStats();
+void releasePCBFrames(struct PCB *pcb);
+void lockPaging();
+void unlockPaging();
+int pinPage(struct PCB *pcb, int pageNumber);
+void unpinFrame(struct PCB *pcb);
+int waitForLine(struct PCB *pcb);
+void waitForScript(struct PCB *pcb);
+void waitForScriptLoader();
 
 #endif